@@ -0,0 +1,95 @@
+//
+// Frame arena - linear allocator for transient CPU data, reset wholesale at the end of each frame
+//
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "arena.h"
+
+// #define ARENA_DEBUG
+
+FrameArena::FrameArena(size_t capacity)
+    : mBuffer ((unsigned char*)malloc(capacity))
+    , mCapacity (mBuffer ? capacity : 0)
+    , mUsed (0)
+    , mFrameHighWater (0)
+    , mHighWater (0)
+    , mFrames (0)
+    , mHeapAllocations (0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    reset();
+    free(mBuffer);
+}
+
+FrameArena& FrameArena::frame()
+{
+    static FrameArena arena;
+    return arena;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+    uintptr_t base = (uintptr_t)mBuffer;
+    size_t start = ((base + mUsed + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+    mUsed = start + size;
+    mFrameHighWater = std::max(mFrameHighWater, mUsed);
+    if (mUsed <= mCapacity)
+        return mBuffer + start;
+
+    // Full: overflow to the heap for the rest of the frame
+    void* overflow = nullptr;
+    if (posix_memalign(&overflow, std::max(alignment, sizeof(void*)), size) != 0)
+        return nullptr;
+    mOverflow.push_back(overflow);
+    mHeapAllocations++;
+    return overflow;
+}
+
+void FrameArena::rewind(size_t marker)
+{
+    // Overflow allocations stay until reset, only the arena offset rewinds
+    mUsed = std::min(mUsed, marker);
+}
+
+void FrameArena::reset()
+{
+    for (void* overflow : mOverflow)
+        free(overflow);
+    mOverflow.clear();
+
+    #ifdef ARENA_DEBUG
+        if (mHeapAllocations > 0)
+            printf("frame %u: %u arena heap allocations, high-water %u of %u bytes\n", 
+                   mFrames, mHeapAllocations, (unsigned int)mFrameHighWater, (unsigned int)mCapacity);
+    #endif
+
+    // Grow to fit this frame, so the next frame like it doesn't overflow
+    if (mFrameHighWater > mCapacity)
+    {
+        size_t capacity = std::max(mFrameHighWater, mCapacity + mCapacity / 2);
+        unsigned char* buffer = (unsigned char*)malloc(capacity);
+        if (buffer)
+        {
+            free(mBuffer);
+            mBuffer = buffer;
+            mCapacity = capacity;
+        }
+        else
+            printf("ERROR: Frame arena could not grow to %u bytes\n", (unsigned int)capacity);
+    }
+
+    mHighWater = std::max(mHighWater, mFrameHighWater);
+    mFrameHighWater = mUsed = 0;
+    mHeapAllocations = 0;
+    mFrames++;
+}
+
+FrameArena::Stats FrameArena::stats()
+{
+    return { mCapacity, mUsed, std::max(mHighWater, mFrameHighWater), mFrames, mHeapAllocations };
+}
@@ -0,0 +1,53 @@
+//
+// Frame arena - linear allocator for transient CPU data, reset wholesale at the end of each frame
+//
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+class FrameArena
+{
+public:
+    FrameArena(size_t capacity = 1 << 20);
+    ~FrameArena();
+
+    // Shared arena for the main (GL) thread; not thread safe
+    static FrameArena& frame();
+
+    // Allocation is a pointer bump. When the arena is full, allocations overflow to the heap until the next
+    // reset, which grows the arena to the frame's high-water mark, so steady state frames don't touch the heap.
+    void* allocate(size_t size, size_t alignment = 16);
+    template <typename T> T* allocate(size_t count) { return (T*)allocate(count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16); }
+
+    // Free everything allocated this frame
+    void reset();
+
+    // Scratch allocations rewind to a marker, for transient buffers within a frame (see ScratchScope)
+    size_t marker() { return mUsed; }
+    void rewind(size_t marker);
+
+    // used and heapAllocations are for the current frame, highWater is over all frames
+    struct Stats { size_t capacity, used, highWater; unsigned int frames, heapAllocations; };
+    Stats stats();
+
+private:
+    unsigned char* mBuffer;
+    size_t mCapacity, mUsed, mFrameHighWater, mHighWater;
+    std::vector<void*> mOverflow;
+    unsigned int mFrames, mHeapAllocations;
+};
+
+// Scratch allocations from an arena, freed when the scope ends
+class ScratchScope
+{
+public:
+    ScratchScope(FrameArena& arena = FrameArena::frame()) : mArena (arena), mMarker (arena.marker()) {}
+    ~ScratchScope() { mArena.rewind(mMarker); }
+
+    void* allocate(size_t size, size_t alignment = 16) { return mArena.allocate(size, alignment); }
+    template <typename T> T* allocate(size_t count) { return mArena.allocate<T>(count); }
+
+private:
+    FrameArena& mArena;
+    size_t mMarker;
+};
@@ -0,0 +1,377 @@
+//
+// Asset loader - reads and decodes startup assets on worker threads, and uploads them on the GL context thread,
+// and asset manifests, which fetch each of a sample's files on its first request
+//
+#include <algorithm>
+#include <stdio.h>
+#include <SDL.h>
+#include "assets.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#include <sys/stat.h>
+#endif
+
+// #define ASSETS_DEBUG
+
+bool readFile(const char* filename, std::vector<unsigned char>& data)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    bool ok = size >= 0;
+    if (ok)
+    {
+        data.resize(size);
+        ok = fread(data.data(), 1, size, file) == (size_t)size;
+    }
+    fclose(file);
+    return ok;
+}
+
+#ifdef THREADPOOL_THREADS
+// Shared between the context thread and workers while AssetLoader::run() is active
+static std::mutex jobMutex;
+static std::condition_variable jobDecoded;
+#endif
+
+AssetLoader::AssetLoader(ThreadPool& pool)
+    : mPool (pool)
+    , mUploadCount (0)
+    , mStartCounter (0)
+    , mEndCounter (0)
+{
+}
+
+AssetLoader::~AssetLoader()
+{
+#ifdef THREADPOOL_THREADS
+    // Jobs still decoding reference this loader
+    if (mGroup)
+        mGroup->wait();
+#endif
+}
+
+int AssetLoader::add(const char* name, Stage load, Stage decode, Stage upload, const std::vector<int>& dependsOn)
+{
+    Job job;
+    job.name = name;
+    job.stages[Load] = load;
+    job.stages[Decode] = decode;
+    job.stages[Upload] = upload;
+    job.dependsOn = dependsOn;
+    for (Span& span : job.spans)
+        span = {0, 0, -1};
+    job.decoded = job.uploaded = false;
+    mJobs.push_back(job);
+    return (int)mJobs.size() - 1;
+}
+
+void AssetLoader::runStage(Job& job, StageIndex stage)
+{
+    if (!job.stages[stage])
+        return;
+
+    const int thread = ThreadPool::currentThread();
+    job.spans[stage].thread = thread;
+    job.spans[stage].start = SDL_GetPerformanceCounter();
+    job.stages[stage]();
+    job.spans[stage].end = SDL_GetPerformanceCounter();
+
+    #ifdef ASSETS_DEBUG
+        printf("%s stage %d done on thread %d\n", job.name.c_str(), (int)stage, thread);
+    #endif
+}
+
+bool AssetLoader::uploadReady(const Job& job)
+{
+    if (!job.decoded)
+        return false;
+    for (int dependency : job.dependsOn)
+        if (!mJobs[dependency].uploaded)
+            return false;
+    return true;
+}
+
+void AssetLoader::start()
+{
+    mStartCounter = SDL_GetPerformanceCounter();
+    mUploadCount = 0;
+
+#ifdef THREADPOOL_THREADS
+    // Load and decode as pool tasks. Jobs without worker stages are ready to upload right away.
+    mGroup.reset(new TaskGroup(mPool));
+    for (Job& job : mJobs)
+    {
+        job.decoded = !job.stages[Load] && !job.stages[Decode];
+        if (job.decoded)
+            continue;
+
+        mGroup->run([this, &job]()
+        {
+            runStage(job, Load);
+            runStage(job, Decode);
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                job.decoded = true;
+            }
+            jobDecoded.notify_one();
+        });
+    }
+#endif
+}
+
+void AssetLoader::run()
+{
+    start();
+
+#ifdef THREADPOOL_THREADS
+    // Upload on this thread, the one with the GL context, in job order as jobs become ready. 
+    // While none is ready, help with the loads and decodes (all of them, if the pool has no workers).
+    for (; mUploadCount < mJobs.size(); ++mUploadCount)
+    {
+        Job* readyJob = nullptr;
+        while (!readyJob)
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            for (Job& job : mJobs)
+                if (!job.uploaded && uploadReady(job))
+                {
+                    readyJob = &job;
+                    break;
+                }
+            if (readyJob)
+                break;
+
+            lock.unlock();
+            if (mPool.runPendingTask())
+                continue;
+
+            // Remaining tasks are running on workers, which notify as they finish
+            lock.lock();
+            jobDecoded.wait(lock, [this]()
+            {
+                for (const Job& job : mJobs)
+                    if (!job.uploaded && uploadReady(job))
+                        return true;
+                return false;
+            });
+        }
+        runStage(*readyJob, Upload);
+        readyJob->uploaded = true;
+    }
+    mGroup->wait();
+    mGroup.reset();
+#else
+    // Single threaded: jobs in order, which satisfies dependencies on earlier jobs
+    for (Job& job : mJobs)
+    {
+        runStage(job, Load);
+        runStage(job, Decode);
+        job.decoded = true;
+        runStage(job, Upload);
+        job.uploaded = true;
+    }
+    mUploadCount = mJobs.size();
+#endif
+
+    mEndCounter = SDL_GetPerformanceCounter();
+}
+
+bool AssetLoader::update()
+{
+    if (mUploadCount == mJobs.size())
+        return true;
+
+#ifdef THREADPOOL_THREADS
+    // Without workers, nothing else runs the tasks
+    if (mPool.threadCount() == 1)
+        mPool.runPendingTask();
+#else
+    for (Job& job : mJobs)
+        if (!job.decoded)
+        {
+            runStage(job, Load);
+            runStage(job, Decode);
+            job.decoded = true;
+            break;
+        }
+#endif
+
+    uploadReadyJobs();
+    if (mUploadCount < mJobs.size())
+        return false;
+
+#ifdef THREADPOOL_THREADS
+    mGroup->wait();
+    mGroup.reset();
+#endif
+    mEndCounter = SDL_GetPerformanceCounter();
+    return true;
+}
+
+// Upload every job that's ready, without waiting for others
+void AssetLoader::uploadReadyJobs()
+{
+    while (true)
+    {
+        Job* readyJob = nullptr;
+        {
+#ifdef THREADPOOL_THREADS
+            std::lock_guard<std::mutex> lock(jobMutex);
+#endif
+            for (Job& job : mJobs)
+                if (!job.uploaded && uploadReady(job))
+                {
+                    readyJob = &job;
+                    break;
+                }
+        }
+        if (!readyJob)
+            return;
+
+        runStage(*readyJob, Upload);
+        readyJob->uploaded = true;
+        mUploadCount++;
+    }
+}
+
+void AssetLoader::printTimeline()
+{
+    const char* stageNames[StageCount] = {"load", "decode", "upload"};
+    auto ms = [this](Uint64 counter) { return (counter - mStartCounter) * 1000.0 / SDL_GetPerformanceFrequency(); };
+
+    printf("INFO: Startup timeline, %d threads (ms since start)\n", mPool.threadCount());
+    for (const Job& job : mJobs)
+    {
+        printf("INFO:   %-32s", job.name.c_str());
+        for (int stage = 0; stage < StageCount; ++stage)
+        {
+            const Span& span = job.spans[stage];
+            if (span.thread < 0)
+                continue;
+            if (span.thread == 0)
+                printf(" %s %.2f-%.2f [main]", stageNames[stage], ms(span.start), ms(span.end));
+            else
+                printf(" %s %.2f-%.2f [worker %d]", stageNames[stage], ms(span.start), ms(span.end), span.thread);
+        }
+        printf("\n");
+    }
+    printf("INFO: Startup total %.2f ms\n", ms(mEndCounter));
+}
+
+AssetManifest::AssetManifest(std::initializer_list<const char*> paths, const char* baseUrl)
+    : mBaseUrl (baseUrl)
+    , mStartCounter (SDL_GetPerformanceCounter())
+{
+    for (const char* path : paths)
+        mEntries.push_back({ path, Unrequested, 0, 0, {} });
+}
+
+void AssetManifest::request(const char* path, Callback onReady)
+{
+    Entry* entry = nullptr;
+    for (Entry& e : mEntries)
+        if (e.path == path)
+            entry = &e;
+    if (!entry)
+    {
+        // Not deployed with the sample, so it can't be fetched
+        printf("ERROR: %s isn't in the asset manifest\n", path);
+        mEntries.push_back({ path, Failed, 0, 0, {} });
+        entry = &mEntries.back();
+    }
+
+    entry->callbacks.push_back(onReady);
+    if (entry->state != Unrequested)
+        return;
+
+    entry->state = Fetching;
+    entry->requestCounter = SDL_GetPerformanceCounter();
+#ifdef __EMSCRIPTEN__
+    std::string url = mBaseUrl + entry->path;
+    emscripten_async_wget_data(url.c_str(), entry, onFetched, onFetchFailed);
+#else
+    // Already on disk: just check it's there
+    FILE* file = fopen(path, "rb");
+    if (file)
+    {
+        fseek(file, 0, SEEK_END);
+        entry->bytes = (size_t)std::max(ftell(file), 0L);
+        fclose(file);
+    }
+    finish(*entry, file != nullptr);
+#endif
+}
+
+void AssetManifest::finish(Entry& entry, bool fetched)
+{
+    entry.state = fetched ? Fetched : Failed;
+    double ms = (SDL_GetPerformanceCounter() - entry.requestCounter) * 1000.0 / SDL_GetPerformanceFrequency();
+    if (fetched)
+        printf("INFO: Fetched %s, %.1f KB in %.2f ms\n", entry.path.c_str(), entry.bytes / 1024.0, ms);
+    else
+        printf("ERROR: Can't fetch %s\n", entry.path.c_str());
+}
+
+void AssetManifest::onFetched(void* arg, void* buffer, int size)
+{
+    Entry& entry = *(Entry*)arg;
+#ifdef __EMSCRIPTEN__
+    // Into MEMFS at its path, creating its directories, so it reads like any other file
+    for (size_t slash = entry.path.find('/'); slash != std::string::npos; slash = entry.path.find('/', slash + 1))
+        mkdir(entry.path.substr(0, slash).c_str(), 0777);
+#endif
+    FILE* file = fopen(entry.path.c_str(), "wb");
+    bool written = file && fwrite(buffer, 1, size, file) == (size_t)size;
+    if (file)
+        fclose(file);
+    entry.bytes = size;
+    finish(entry, written);
+}
+
+void AssetManifest::onFetchFailed(void* arg)
+{
+    finish(*(Entry*)arg, false);
+}
+
+void AssetManifest::update()
+{
+    // By index, as callbacks may request files, adding entries
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        Entry& entry = mEntries[i];
+        if ((entry.state != Fetched && entry.state != Failed) || entry.callbacks.empty())
+            continue;
+
+        std::vector<Callback> callbacks;
+        callbacks.swap(entry.callbacks);
+        bool fetched = entry.state == Fetched;
+        for (Callback& callback : callbacks)
+            callback(fetched);
+    }
+}
+
+void AssetManifest::printReport(const char* label)
+{
+    int fetched = 0, pending = 0;
+    size_t fetchedBytes = 0;
+    for (const Entry& entry : mEntries)
+    {
+        if (entry.state == Fetched)
+        {
+            fetched++;
+            fetchedBytes += entry.bytes;
+        }
+        else if (entry.state == Fetching)
+            pending++;
+    }
+    printf("INFO: Assets %s (%.2f ms): %d of %d files fetched, %.1f KB, %d pending\n", label,
+           (SDL_GetPerformanceCounter() - mStartCounter) * 1000.0 / SDL_GetPerformanceFrequency(),
+           fetched, (int)mEntries.size(), fetchedBytes / 1024.0, pending);
+}
@@ -0,0 +1,109 @@
+//
+// Asset loader - reads and decodes startup assets on worker threads, and uploads them on the GL context thread,
+// and asset manifests, which fetch each of a sample's files on its first request
+//
+#pragma once
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "threadpool.h"
+
+// Read a whole file into memory, returning false if it can't be read
+bool readFile(const char* filename, std::vector<unsigned char>& data);
+
+// Where the browser fetches manifest paths from, relative to the page, e.g. -DASSET_BASE_URL='"src/"'
+#ifndef ASSET_BASE_URL
+#define ASSET_BASE_URL ""
+#endif
+
+// The files a sample may load, each fetched on its own when first requested, rather than packaged with
+// --preload-file, which holds up startup until every file is downloaded. In the browser a file is fetched with
+// emscripten_async_wget_data and written to MEMFS at its path; natively it's read from disk where it is. Either way
+// it's then at its path for readFile, fopen and SDL_RWFromFile. Main thread only.
+class AssetManifest
+{
+public:
+    // Called once a requested file is at its path (fetched true), or couldn't be fetched
+    typedef std::function<void(bool fetched)> Callback;
+
+    AssetManifest(std::initializer_list<const char*> paths, const char* baseUrl = ASSET_BASE_URL);
+
+    // Request a file in the manifest, starting its fetch the first time. onReady runs from a later update(), even
+    // for files already fetched, so it always runs between frames.
+    void request(const char* path, Callback onReady);
+
+    // Call once per frame: runs the callbacks of requests that completed
+    void update();
+
+    // Fetched and pending files and bytes so far, e.g. after init for what startup waited on
+    void printReport(const char* label);
+
+private:
+    enum State { Unrequested, Fetching, Fetched, Failed };
+    struct Entry
+    {
+        std::string path;
+        State state;
+        size_t bytes;
+        Uint64 requestCounter;
+        std::vector<Callback> callbacks;
+    };
+    static void finish(Entry& entry, bool fetched);
+    static void onFetched(void* arg, void* buffer, int size);
+    static void onFetchFailed(void* arg);
+
+    std::string mBaseUrl;
+    std::deque<Entry> mEntries; // Stay put as entries are added, for fetches in flight
+    Uint64 mStartCounter;
+};
+
+class AssetLoader
+{
+public:
+    // Load (file I/O) and decode (CPU work) stages run as thread pool tasks, or inline in single threaded builds
+    AssetLoader(ThreadPool& pool = ThreadPool::shared());
+    ~AssetLoader();
+
+    // Add an asset job, returning its id. Any stage may be null; jobs with only an upload stage (e.g. shader 
+    // compilation) just run on the context thread. The upload runs after the uploads of jobs in dependsOn.
+    typedef std::function<void()> Stage;
+    int add(const char* name, Stage load, Stage decode, Stage upload, const std::vector<int>& dependsOn = {});
+
+    // Run all jobs, returning when every upload is done. Uploads run in job order as soon as they're ready,
+    // overlapping with loads and decodes still running on workers.
+    void run();
+
+    // Or start all jobs without waiting, and call update() once per frame until it returns true. Each update runs
+    // the uploads that are ready, so frames keep drawing while loads and decodes run on workers. Without workers,
+    // each update loads and decodes one job, spreading the work over frames rather than stalling one.
+    void start();
+    bool update();
+
+    // Print per-asset load, decode and upload spans, in ms since run() started
+    void printTimeline();
+
+private:
+    enum StageIndex { Load, Decode, Upload, StageCount };
+    struct Span { Uint64 start, end; int thread; };
+    struct Job
+    {
+        std::string name;
+        Stage stages[StageCount];
+        std::vector<int> dependsOn;
+        Span spans[StageCount];
+        bool decoded, uploaded;
+    };
+    void runStage(Job& job, StageIndex stage);
+    bool uploadReady(const Job& job);
+    void uploadReadyJobs();
+
+    ThreadPool& mPool;
+    std::vector<Job> mJobs;
+    size_t mUploadCount;
+#ifdef THREADPOOL_THREADS
+    std::unique_ptr<TaskGroup> mGroup; // Loads and decodes, from start() until they're done
+#endif
+    Uint64 mStartCounter, mEndCounter;
+};
@@ -0,0 +1,203 @@
+//
+// Texture atlas - packs many small images into shared texture pages, so they can be drawn without texture switches
+//
+#include <algorithm>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_opengles2.h>
+#include "atlas.h"
+
+static double elapsedMs(Uint64 startCounter)
+{
+    return (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+TextureAtlas::TextureAtlas(int pageSize, int padding, GLenum format)
+    : mPageSize (pageSize)
+    , mPadding (padding)
+    , mBytesPerPixel (format == GL_ALPHA ? 1 : 4)
+    , mFormat (format)
+    , mPackMs (0.0)
+    , mBuildMs (0.0)
+{
+}
+
+// Y position where a width x height rect fits with its left edge at skyline node, or -1 if it doesn't fit
+int TextureAtlas::fit(Page& page, size_t node, int width, int height)
+{
+    int x = page.skyline[node].x;
+    if (x + width > mPageSize)
+        return -1;
+
+    int y = 0, widthLeft = width;
+    for (size_t i = node; widthLeft > 0; ++i)
+    {
+        y = std::max(y, page.skyline[i].y);
+        if (y + height > mPageSize)
+            return -1;
+        widthLeft -= page.skyline[i].width;
+    }
+    return y;
+}
+
+// Raise the skyline under a placed rect, trimming or removing the nodes it covers and merging equal heights
+void TextureAtlas::addSkylineNode(Page& page, size_t node, int x, int y, int width, int height)
+{
+    std::vector<SkylineNode>& skyline = page.skyline;
+    skyline.insert(skyline.begin() + node, {x, y + height, width});
+
+    for (size_t i = node + 1; i < skyline.size(); )
+    {
+        int overlap = skyline[i - 1].x + skyline[i - 1].width - skyline[i].x;
+        if (overlap <= 0)
+            break;
+        skyline[i].x += overlap;
+        skyline[i].width -= overlap;
+        if (skyline[i].width <= 0)
+            skyline.erase(skyline.begin() + i);
+        else
+            break;
+    }
+
+    for (size_t i = 0; i + 1 < skyline.size(); )
+    {
+        if (skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else
+            ++i;
+    }
+}
+
+// Bottom-left skyline placement: lowest top edge, then narrowest node
+bool TextureAtlas::place(Page& page, int width, int height, int& x, int& y)
+{
+    int bestTop = mPageSize + 1, bestWidth = 0;
+    size_t bestNode = 0;
+    for (size_t i = 0; i < page.skyline.size(); ++i)
+    {
+        int fitY = fit(page, i, width, height);
+        if (fitY >= 0 && (fitY + height < bestTop || (fitY + height == bestTop && page.skyline[i].width < bestWidth)))
+        {
+            bestTop = fitY + height;
+            bestWidth = page.skyline[i].width;
+            bestNode = i;
+            y = fitY;
+        }
+    }
+    if (bestTop > mPageSize)
+        return false;
+
+    x = page.skyline[bestNode].x;
+    addSkylineNode(page, bestNode, x, y, width, height);
+    return true;
+}
+
+// Copy an image into a page at (x,y) (the padded rect's corner), replicating edge texels into the padding
+void TextureAtlas::copyPadded(Page& page, const GLubyte* pixels, int width, int height, int pitch, int x, int y)
+{
+    const int paddedWidth = width + mPadding * 2, paddedHeight = height + mPadding * 2;
+    for (int row = 0; row < paddedHeight; ++row)
+    {
+        int srcRow = std::max(0, std::min(row - mPadding, height - 1));
+        const GLubyte* src = pixels + srcRow * pitch;
+        GLubyte* dest = &page.pixels[((y + row) * mPageSize + x) * mBytesPerPixel];
+
+        for (int col = 0; col < mPadding; ++col)
+            memcpy(dest + col * mBytesPerPixel, src, mBytesPerPixel);
+        memcpy(dest + mPadding * mBytesPerPixel, src, width * mBytesPerPixel);
+        for (int col = mPadding + width; col < paddedWidth; ++col)
+            memcpy(dest + col * mBytesPerPixel, src + (width - 1) * mBytesPerPixel, mBytesPerPixel);
+    }
+}
+
+int TextureAtlas::add(const GLubyte* pixels, int width, int height, int pitch)
+{
+    Uint64 startCounter = SDL_GetPerformanceCounter();
+
+    const int paddedWidth = width + mPadding * 2, paddedHeight = height + mPadding * 2;
+    if (width <= 0 || height <= 0 || paddedWidth > mPageSize || paddedHeight > mPageSize)
+        return -1;
+
+    // Try existing pages first, then start a new one
+    int x = 0, y = 0;
+    size_t pageIndex = 0;
+    while (pageIndex < mPages.size() && !place(mPages[pageIndex], paddedWidth, paddedHeight, x, y))
+        pageIndex++;
+    if (pageIndex == mPages.size())
+    {
+        mPages.push_back({ { {0, 0, mPageSize} }, std::vector<GLubyte>(mPageSize * mPageSize * mBytesPerPixel, 0), GLTexture() });
+        place(mPages.back(), paddedWidth, paddedHeight, x, y);
+    }
+
+    copyPadded(mPages[pageIndex], pixels, width, height, pitch, x, y);
+
+    Region region;
+    region.page = (int)pageIndex;
+    region.x = x + mPadding;
+    region.y = y + mPadding;
+    region.width = width;
+    region.height = height;
+    region.u0 = region.x / (GLfloat)mPageSize;
+    region.v0 = region.y / (GLfloat)mPageSize;
+    region.u1 = (region.x + width) / (GLfloat)mPageSize;
+    region.v1 = (region.y + height) / (GLfloat)mPageSize;
+    mRegions.push_back(region);
+
+    mPackMs += elapsedMs(startCounter);
+    return (int)mRegions.size() - 1;
+}
+
+void TextureAtlas::build(GLint filter)
+{
+    Uint64 startCounter = SDL_GetPerformanceCounter();
+
+    for (Page& page : mPages)
+    {
+        if (page.texture == 0)
+            page.texture = GLTexture::create();
+        glBindTexture(GL_TEXTURE_2D, page.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        page.texture.image2D(0, mFormat, mPageSize, mPageSize, GL_UNSIGNED_BYTE, page.pixels.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4); // GL default, which other uploads assume
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    mBuildMs = elapsedMs(startCounter);
+
+    Stats atlasStats = stats();
+    printf("INFO: Atlas %d images in %d pages of %dx%d, %.1f%% used, packed in %.2f ms, built in %.2f ms\n", 
+           regionCount(), pageCount(), mPageSize, mPageSize, atlasStats.efficiency * 100.0f, atlasStats.packMs, atlasStats.buildMs);
+}
+
+TextureAtlas::Stats TextureAtlas::stats()
+{
+    double imageArea = 0.0;
+    for (const Region& region : mRegions)
+        imageArea += (double)region.width * region.height;
+    double pageArea = (double)mPageSize * mPageSize * std::max((size_t)1, mPages.size());
+    return { (float)(imageArea / pageArea), mPackMs, mBuildMs };
+}
+
+// Text table, one line per image: id page x y width height u0 v0 u1 v1
+bool TextureAtlas::writeRemapTable(const char* filename)
+{
+    FILE* file = fopen(filename, "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "# id page x y width height u0 v0 u1 v1\n");
+    for (size_t i = 0; i < mRegions.size(); ++i)
+    {
+        const Region& r = mRegions[i];
+        fprintf(file, "%d %d %d %d %d %d %f %f %f %f\n", (int)i, r.page, r.x, r.y, r.width, r.height, r.u0, r.v0, r.u1, r.v1);
+    }
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,47 @@
+//
+// Texture atlas - packs many small images into shared texture pages, so they can be drawn without texture switches
+//
+#pragma once
+#include <vector>
+#include "glresource.h"
+
+class TextureAtlas
+{
+public:
+    // Pages are pageSize x pageSize, in format GL_RGBA (4 bytes per pixel) or GL_ALPHA (1 byte per pixel).
+    // Images are separated by padding texels of their own replicated edge, so filtering doesn't bleed neighbors in.
+    TextureAtlas(int pageSize = 1024, int padding = 1, GLenum format = GL_RGBA);
+
+    // Pack an image (rows of pitch bytes) using skyline bottom-left packing, returning its id, or -1 if it's too large
+    int add(const GLubyte* pixels, int width, int height, int pitch);
+
+    // Upload the pages to GL textures, with the given filter
+    void build(GLint filter = GL_LINEAR);
+
+    // UV remap table: where each image id ended up
+    struct Region { int page; int x, y, width, height; GLfloat u0, v0, u1, v1; };
+    const Region& region(int id) { return mRegions[id]; }
+    int regionCount() { return (int)mRegions.size(); }
+    bool writeRemapTable(const char* filename);
+
+    int pageCount() { return (int)mPages.size(); }
+    GLuint pageTexture(int page) { return mPages[page].texture; }
+
+    // Fraction of page area covered by images (excluding padding), and time spent packing and building
+    struct Stats { float efficiency; double packMs, buildMs; };
+    Stats stats();
+
+private:
+    struct SkylineNode { int x, y, width; };
+    struct Page { std::vector<SkylineNode> skyline; std::vector<GLubyte> pixels; GLTexture texture; };
+    bool place(Page& page, int width, int height, int& x, int& y);
+    int fit(Page& page, size_t node, int width, int height);
+    void addSkylineNode(Page& page, size_t node, int x, int y, int width, int height);
+    void copyPadded(Page& page, const GLubyte* pixels, int width, int height, int pitch, int x, int y);
+
+    int mPageSize, mPadding, mBytesPerPixel;
+    GLenum mFormat;
+    std::vector<Page> mPages;
+    std::vector<Region> mRegions;
+    double mPackMs, mBuildMs;
+};
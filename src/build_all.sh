@@ -1,8 +1,13 @@
 # Requires Emscripten to build: https://kripken.github.io/emscripten-site/docs/getting_started/downloads.html
 set -o verbose
 emcc -std=c++11 hello_triangle_minimal.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=0 -o ../hello_triangle_minimal.js
-emcc -std=c++11 hello_triangle.cpp events.cpp camera.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=0 -o ../hello_triangle.js
-emcc -std=c++11 hello_texture.cpp events.cpp camera.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s SDL2_IMAGE_FORMATS="[""png""]" -s FULL_ES2=1 -s WASM=0 --preload-file media/texmap.png -o ../hello_texture.js
-emcc -std=c++11 hello_text_ttf.cpp events.cpp camera.cpp -s USE_SDL=2 -s USE_SDL_TTF=2 -s FULL_ES2=1 -s WASM=0 --preload-file media/LiberationSansBold.ttf -o ../hello_text_ttf.js
-emcc -std=c++11 hello_text_txf.cpp events.cpp camera.cpp texfont.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=0 --preload-file media/rockfont.txf -o ../hello_text_txf.js
-emcc -std=c++11 hello_image.cpp events.cpp camera.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s FULL_ES2=1 -s WASM=0 -s ALLOW_MEMORY_GROWTH=1 -o ../hello_image.js
+emcc -std=c++11 hello_triangle.cpp events.cpp camera.cpp glresource.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=0 -o ../hello_triangle.js
+emcc -std=c++11 hello_texture.cpp events.cpp camera.cpp assets.cpp threadpool.cpp glresource.cpp texturemanager.cpp pixels.cpp pngstream.cpp texcompress.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s USE_LIBPNG=1 -s SDL2_IMAGE_FORMATS="[""png""]" -s FULL_ES2=1 -s WASM=0 -DASSET_BASE_URL='"src/"' -o ../hello_texture.js
+emcc -std=c++11 -msimd128 -msse2 hello_texture.cpp events.cpp camera.cpp assets.cpp threadpool.cpp glresource.cpp texturemanager.cpp pixels.cpp pngstream.cpp texcompress.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s USE_LIBPNG=1 -s SDL2_IMAGE_FORMATS="[""png""]" -s FULL_ES2=1 -s WASM=1 -DASSET_BASE_URL='"src/"' -o ../hello_texture_simd.html
+emcc -std=c++11 hello_text_ttf.cpp events.cpp camera.cpp assets.cpp threadpool.cpp glresource.cpp texturemanager.cpp sdf.cpp mipmap.cpp -s USE_SDL=2 -s USE_SDL_TTF=2 -s FULL_ES2=1 -s WASM=0 -DASSET_BASE_URL='"src/"' -o ../hello_text_ttf.js
+emcc -std=c++11 hello_text_txf.cpp events.cpp camera.cpp texfont.cpp streambuffer.cpp assets.cpp threadpool.cpp arena.cpp glresource.cpp texturemanager.cpp mipmap.cpp atlas.cpp heapcount.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=0 -DASSET_BASE_URL='"src/"' -o ../hello_text_txf.js
+emcc -std=c++11 -msimd128 -msse2 hello_text_txf.cpp events.cpp camera.cpp texfont.cpp streambuffer.cpp assets.cpp threadpool.cpp arena.cpp glresource.cpp texturemanager.cpp mipmap.cpp atlas.cpp heapcount.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=1 -DASSET_BASE_URL='"src/"' -o ../hello_text_txf_simd.html
+emcc -std=c++11 -DCOUNT_HEAP_ALLOCATIONS hello_text_txf.cpp events.cpp camera.cpp texfont.cpp streambuffer.cpp assets.cpp threadpool.cpp arena.cpp glresource.cpp texturemanager.cpp mipmap.cpp atlas.cpp heapcount.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=1 -DASSET_BASE_URL='"src/"' -o ../hello_text_txf_heapcount.html
+emcc -std=c++11 hello_image.cpp events.cpp camera.cpp threadpool.cpp arena.cpp glresource.cpp texturemanager.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s FULL_ES2=1 -s WASM=0 -s ALLOW_MEMORY_GROWTH=1 -o ../hello_image.js
+emcc -std=c++11 -pthread hello_image.cpp events.cpp camera.cpp threadpool.cpp arena.cpp glresource.cpp texturemanager.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s FULL_ES2=1 -s WASM=1 -s USE_PTHREADS=1 -s PTHREAD_POOL_SIZE=navigator.hardwareConcurrency -s ALLOW_MEMORY_GROWTH=1 -o ../hello_image_pthreads.html
+emcc -std=c++11 hello_sprites.cpp events.cpp camera.cpp spatial.cpp spritebatch.cpp streambuffer.cpp atlas.cpp glresource.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=0 -s ALLOW_MEMORY_GROWTH=1 -o ../hello_sprites.js
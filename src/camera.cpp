@@ -2,10 +2,20 @@
 // Camera - pan, zoom, and window resizing
 //
 #include <algorithm>
+#include <math.h>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
 #include <SDL.h>
 #include <SDL_opengles2.h>
 #include "camera.h"
 
+// #define CAMERA_DEBUG
+
 bool Camera::updated()
 {
     bool updated = mCameraUpdated;
@@ -32,7 +42,7 @@ void Camera::setWindowSize(int width, int height)
 }
 
 // Clamp val between lo and hi
-float Camera::clamp (float val, float lo, float hi) 
+double Camera::clamp (double val, double lo, double hi) 
 { 
     return std::max(lo, std::min(val, hi)); 
 }
@@ -51,14 +61,24 @@ void Camera::windowToDeviceCoords (int winX, int winY, float& deviceX, float& de
 }
 
 // Convert from device coords ([-1.0, 1.0], [-1.0,1.0]) to world coords ([-inf, inf], [-inf, inf])
-void Camera::deviceToWorldCoords (float deviceX, float deviceY, float& worldX, float& worldY)
+void Camera::deviceToWorldCoords (float deviceX, float deviceY, double& worldX, double& worldY)
 {
     worldX = deviceX / mZoom - mPan.x;
     worldY = deviceY / mAspect / mZoom - mPan.y;
 }
 
+// Convert world coords (x,y pairs) to float offsets from the eye, for geometry drawn with a zero pan uniform
+void Camera::worldToEyeRelative (const double* worldXY, GLfloat* eyeXY, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        eyeXY[i * 2] = (GLfloat)(worldXY[i * 2] + mPan.x);
+        eyeXY[i * 2 + 1] = (GLfloat)(worldXY[i * 2 + 1] + mPan.y);
+    }
+}
+
 // Convert from window coords (x,y) in ([0, windowWidth], [windowHeight, 0]) to world coords ([-inf, inf], [-inf, inf])
-void Camera::windowToWorldCoords(int winX, int winY, float& worldX, float& worldY)
+void Camera::windowToWorldCoords(int winX, int winY, double& worldX, double& worldY)
 {
     float deviceX, deviceY;
     windowToDeviceCoords(winX, winY, deviceX, deviceY);   
@@ -66,9 +86,198 @@ void Camera::windowToWorldCoords(int winX, int winY, float& worldX, float& world
 }
 
 // Convert from normalized window coords (x,y) in in ([0.0, 1.0], [1.0, 0.0]) to world coords ([-inf, inf], [-inf, inf])
-void Camera::normWindowToWorldCoords(float normWinX, float normWinY, float& worldX, float& worldY)
+void Camera::normWindowToWorldCoords(float normWinX, float normWinY, double& worldX, double& worldY)
 {
     float deviceX, deviceY;
     normWindowToDeviceCoords(normWinX, normWinY, deviceX, deviceY);
     deviceToWorldCoords(deviceX, deviceY, worldX, worldY);
 }
+
+// World space rectangle visible in the window, from device coords corners (-1,-1) and (1,1)
+WorldRect Camera::visibleWorldRect ()
+{
+    WorldRect rect;
+    deviceToWorldCoords(-1.0f, -1.0f, rect.minX, rect.minY);
+    deviceToWorldCoords(1.0f, 1.0f, rect.maxX, rect.maxY);
+    return rect;
+}
+
+// True if world space bounds overlap the visible rectangle, i.e. the object needs to be drawn
+bool Camera::isVisible (const WorldRect& bounds)
+{
+    WorldRect visible = visibleWorldRect();
+    bool overlaps = bounds.maxX >= visible.minX && bounds.minX <= visible.maxX
+                 && bounds.maxY >= visible.minY && bounds.minY <= visible.maxY;
+    if (overlaps)
+        mCullStats.drawn++;
+    else
+        mCullStats.culled++;
+    return overlaps;
+}
+
+// Publish this frame's culling counts and start counting the next frame
+void Camera::endCullFrame ()
+{
+    #ifdef CAMERA_DEBUG
+        if (mCullStats.drawn != mLastCullStats.drawn || mCullStats.culled != mLastCullStats.culled)
+            printf ("cull drawn=%u culled=%u\n", mCullStats.drawn, mCullStats.culled);
+    #endif
+    mLastCullStats = mCullStats;
+    mCullStats = {};
+}
+
+// Window to world, per axis:
+//     worldX = (2 * winX / width - 1) / zoom - panX
+//     worldY = (1 - 2 * winY / height) / aspect / zoom - panY
+// and the inverse for world to window
+void Camera::updateTransforms ()
+{
+    double width = mWindowSize.width, height = mWindowSize.height;
+    double scaleX = 2.0 / (width * mZoom), 
+           scaleY = -2.0 / (height * mAspect * mZoom);
+    double offsetX = -1.0 / mZoom - mPan.x, 
+           offsetY = 1.0 / (mAspect * mZoom) - mPan.y;
+
+    mWindowToWorld[0] = { (float)scaleX, (float)offsetX };
+    mWindowToWorld[1] = { (float)scaleY, (float)offsetY };
+    mWorldToWindow[0] = { (float)(1.0 / scaleX), (float)(-offsetX / scaleX) };
+    mWorldToWindow[1] = { (float)(1.0 / scaleY), (float)(-offsetY / scaleY) };
+    mTransformsDirty = false;
+}
+
+// out[i] = in[i] * scale + offset, 4 at a time where SIMD is available
+static void transformAxis (const float* in, float* out, int count, float scale, float offset)
+{
+    int i = 0;
+#if defined(__SSE__)
+    __m128 scale4 = _mm_set1_ps(scale), offset4 = _mm_set1_ps(offset);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale4), offset4));
+#elif defined(__ARM_NEON)
+    float32x4_t scale4 = vdupq_n_f32(scale), offset4 = vdupq_n_f32(offset);
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(out + i, vmlaq_f32(offset4, vld1q_f32(in + i), scale4));
+#elif defined(__wasm_simd128__)
+    v128_t scale4 = wasm_f32x4_splat(scale), offset4 = wasm_f32x4_splat(offset);
+    for (; i + 4 <= count; i += 4)
+        wasm_v128_store(out + i, wasm_f32x4_add(wasm_f32x4_mul(wasm_v128_load(in + i), scale4), offset4));
+#endif
+    for (; i < count; ++i)
+        out[i] = in[i] * scale + offset;
+}
+
+void Camera::windowToWorldCoords (const float* winX, const float* winY, float* worldX, float* worldY, int count)
+{
+    if (mTransformsDirty)
+        updateTransforms();
+    transformAxis(winX, worldX, count, mWindowToWorld[0].scale, mWindowToWorld[0].offset);
+    transformAxis(winY, worldY, count, mWindowToWorld[1].scale, mWindowToWorld[1].offset);
+}
+
+void Camera::worldToWindowCoords (const float* worldX, const float* worldY, float* winX, float* winY, int count)
+{
+    if (mTransformsDirty)
+        updateTransforms();
+    transformAxis(worldX, winX, count, mWorldToWindow[0].scale, mWorldToWindow[0].offset);
+    transformAxis(worldY, winY, count, mWorldToWindow[1].scale, mWorldToWindow[1].offset);
+}
+
+// Zoom by zoomFactor (> 1 zooms in), keeping the world point under device coords (x,y) fixed.
+// The zoom eases toward the target in animate().
+void Camera::zoomToPoint (float zoomFactor, float deviceX, float deviceY)
+{
+    mZoomTarget = clamp(mZoomTarget * zoomFactor, mZoomMin, mZoomMax);
+    mZoomAnchor = {deviceX, deviceY};
+}
+
+// Start a drag: stop any inertial motion and remember the pan the drag is relative to
+void Camera::beginDrag ()
+{
+    setBasePan();
+    mDragging = true;
+    mDragPrevPan = mPan;
+    mPanVelocity = {0.0, 0.0};
+}
+
+// End a drag, and keep panning with the drag velocity if flick is true
+void Camera::endDrag (bool flick)
+{
+    mDragging = false;
+    if (!flick)
+        mPanVelocity = {0.0, 0.0};
+}
+
+bool Camera::settled ()
+{
+    return !mDragging 
+        && mPanVelocity.x == 0.0 && mPanVelocity.y == 0.0 
+        && mZoom == mZoomTarget && mZoomVelocity == 0.0;
+}
+
+void Camera::animate (float elapsedSeconds)
+{
+    // Estimate drag velocity from the pan applied by input this frame, smoothed over a few frames
+    if (mDragging && elapsedSeconds > 0.0f)
+    {
+        const double smoothing = 0.5;
+        Vec2d velocity = { (mPan.x - mDragPrevPan.x) / elapsedSeconds, (mPan.y - mDragPrevPan.y) / elapsedSeconds };
+        mPanVelocity.x += (velocity.x - mPanVelocity.x) * smoothing;
+        mPanVelocity.y += (velocity.y - mPanVelocity.y) * smoothing;
+        mDragPrevPan = mPan;
+    }
+
+    if (settled())
+    {
+        mTimeAccumulator = 0.0f;
+        return;
+    }
+
+    // Avoid a long catch-up after a stall, e.g. a hidden browser tab
+    const float maxElapsed = 0.25f;
+    mTimeAccumulator += std::min(elapsedSeconds, maxElapsed);
+    while (mTimeAccumulator >= cTimeStep)
+    {
+        step(cTimeStep);
+        mTimeAccumulator -= cTimeStep;
+    }
+}
+
+void Camera::step (float dt)
+{
+    // Zoom: critically damped spring in log space, so equal zoom factors take equal time at any zoom
+    if (mZoom != mZoomTarget || mZoomVelocity != 0.0)
+    {
+        double preZoomWorldX, preZoomWorldY;
+        deviceToWorldCoords(mZoomAnchor.x, mZoomAnchor.y, preZoomWorldX, preZoomWorldY);
+
+        double offset = log(mZoom / mZoomTarget);
+        mZoomVelocity += (-cZoomStiffness * cZoomStiffness * offset - 2.0 * cZoomStiffness * mZoomVelocity) * dt;
+        offset += mZoomVelocity * dt;
+
+        const double settleOffset = 0.0001, settleVelocity = 0.001;
+        if (fabs(offset) < settleOffset && fabs(mZoomVelocity) < settleVelocity)
+        {
+            offset = 0.0;
+            mZoomVelocity = 0.0;
+        }
+        mZoom = clamp(mZoomTarget * exp(offset), mZoomMin, mZoomMax);
+        mCameraUpdated = mTransformsDirty = true;
+
+        // Zoom to point: Keep the world coords under the anchor the same before and after the zoom
+        double postZoomWorldX, postZoomWorldY;
+        deviceToWorldCoords(mZoomAnchor.x, mZoomAnchor.y, postZoomWorldX, postZoomWorldY);
+        setPanDelta({ postZoomWorldX - preZoomWorldX, postZoomWorldY - preZoomWorldY });
+    }
+
+    // Pan: inertial flick after a drag, decaying exponentially until it is below a device space speed
+    if (!mDragging && (mPanVelocity.x != 0.0 || mPanVelocity.y != 0.0))
+    {
+        setPanDelta({ mPanVelocity.x * dt, mPanVelocity.y * dt });
+
+        double decay = exp(-cPanFriction * dt);
+        mPanVelocity.x *= decay;
+        mPanVelocity.y *= decay;
+        if (fabs(mPanVelocity.x) * mZoom < cPanStopSpeed && fabs(mPanVelocity.y) * mZoom < cPanStopSpeed)
+            mPanVelocity = {0.0, 0.0};
+    }
+}
\ No newline at end of file
@@ -3,6 +3,8 @@
 //
 struct Rect { int width, height; };
 struct Vec2 { GLfloat x, y; };
+struct Vec2d { double x, y; };
+struct WorldRect { double minX, minY, maxX, maxY; };
 
 class Camera
 {
@@ -15,35 +17,87 @@ public:
     void setWindowSize (int width, int height);
     GLfloat* viewport() { return (GLfloat*)&mViewport; }
  
-    GLfloat* pan() { return (GLfloat*)&mPan; }
-    GLfloat zoom() { return mZoom; }
+    // Pan and zoom are kept in double precision. pan() is a float copy for printing; the samples rebase
+    // their geometry relative to the eye with worldPan() or worldToEyeRelative() rather than using a pan uniform.
+    GLfloat* pan() { return (GLfloat*)&mPanFloat; }
+    Vec2d& worldPan() { return mPan; }
+    double zoom() { return mZoom; }
     GLfloat aspect() { return mAspect; }
  
-    void setPan (Vec2 pan) { mPan = pan; mCameraUpdated = true; }    
-    void setPanDelta (Vec2 panDelta) { mPan.x += panDelta.x; mPan.y += panDelta.y; mCameraUpdated = true; }
-    void setZoom (GLfloat zoom) { mZoom = clamp(zoom, cZoomMin, cZoomMax); mCameraUpdated = true; }
-    void setZoomDelta (GLfloat zoomDelta) { mZoom = clamp(mZoom + zoomDelta, cZoomMin, cZoomMax); mCameraUpdated = true; }
-    void setAspect (GLfloat aspect) { mAspect = aspect; mCameraUpdated = true; }
+    void setPan (Vec2d pan) { mPan = pan; panUpdated(); }    
+    void setPanDelta (Vec2d panDelta) { mPan.x += panDelta.x; mPan.y += panDelta.y; panUpdated(); }
+    void setZoom (double zoom) { mZoom = mZoomTarget = clamp(zoom, mZoomMin, mZoomMax); mZoomVelocity = 0.0; mCameraUpdated = mTransformsDirty = true; }
+    void setZoomDelta (double zoomDelta) { setZoom(mZoom + zoomDelta); }
+    void setZoomLimits (double zoomMin, double zoomMax) { mZoomMin = zoomMin; mZoomMax = zoomMax; setZoom(mZoom); }
+    void setAspect (GLfloat aspect) { mAspect = aspect; mCameraUpdated = mTransformsDirty = true; }
 
-    Vec2& basePan() { return mBasePan; }
+    Vec2d& basePan() { return mBasePan; }
     void setBasePan () { mBasePan = mPan; }
 
+    // Relative to eye: world position at the center of the window, and world points relative to it.
+    // Offsets near the eye stay small, so they keep full float precision at any zoom.
+    Vec2d eye() { return { -mPan.x, -mPan.y }; }
+    void worldToEyeRelative (const double* worldXY, GLfloat* eyeXY, int count);
+
+    // Animation: smoothed multiplicative zoom to a point, and inertial panning after a drag,
+    // integrated on a fixed timestep independent of frame rate
+    void animate (float elapsedSeconds);
+    bool settled ();   // No drag, inertia or zoom easing in progress, so frames can be skipped until input arrives
+    void zoomToPoint (float zoomFactor, float deviceX, float deviceY);
+    void beginDrag ();
+    void endDrag (bool flick);
+
     void normWindowToDeviceCoords (float normWinX, float normWinY, float& deviceX, float& deviceY);
     void windowToDeviceCoords (int winX, int winY, float& deviceX, float& deviceY);
-    void deviceToWorldCoords (float deviceX, float deviceY, float& worldX, float& worldY);
-    void windowToWorldCoords (int winX, int winY, float& worldX, float& worldY);
-    void normWindowToWorldCoords (float normWinX, float normWinY, float& worldX, float& worldY);
+    void deviceToWorldCoords (float deviceX, float deviceY, double& worldX, double& worldY);
+    void windowToWorldCoords (int winX, int winY, double& worldX, double& worldY);
+    void normWindowToWorldCoords (float normWinX, float normWinY, double& worldX, double& worldY);
+
+    // Culling: world space rectangle covered by the window, and a visibility test against it for world space
+    // object bounds.  Tests are counted as drawn or culled; cullStats() reports the counts for the previous frame,
+    // once the sample calls endCullFrame() after drawing.
+    WorldRect visibleWorldRect ();
+    bool isVisible (const WorldRect& bounds);
+    struct CullStats { unsigned int drawn, culled; };
+    CullStats& cullStats() { return mLastCullStats; }
+    void endCullFrame ();
+
+    // Batch conversions of count points between window and world coords, as separate x and y arrays.
+    // Results are single precision; use the per-point conversions above where deep zoom precision matters.
+    void windowToWorldCoords (const float* winX, const float* winY, float* worldX, float* worldY, int count);
+    void worldToWindowCoords (const float* worldX, const float* worldY, float* winX, float* winY, int count);
 
 private:
-    float clamp (float val, float lo, float hi);
+    double clamp (double val, double lo, double hi);
+    void updateTransforms ();
+    void panUpdated () { mPanFloat = { (GLfloat)mPan.x, (GLfloat)mPan.y }; mCameraUpdated = mTransformsDirty = true; }
+    void step (float dt);
 
     bool mCameraUpdated;
     bool mWindowResized;
     Rect mWindowSize;
     Vec2 mViewport;  
-    const GLfloat cZoomMin, cZoomMax;
-    Vec2 mBasePan, mPan;
-    GLfloat mZoom, mAspect; 
+    double mZoomMin, mZoomMax;
+    Vec2d mBasePan, mPan;
+    Vec2 mPanFloat;
+    double mZoom;
+    GLfloat mAspect; 
+
+    // Cached per-axis scale & offset for batch conversions, rebuilt when pan, zoom, aspect or window size changes
+    struct AxisTransform { float scale, offset; };
+    bool mTransformsDirty;
+    AxisTransform mWindowToWorld[2], mWorldToWindow[2];
+
+    // Culling
+    CullStats mCullStats, mLastCullStats;
+
+    // Animation
+    const float cTimeStep, cZoomStiffness, cPanFriction, cPanStopSpeed;
+    float mTimeAccumulator;
+    double mZoomTarget, mZoomVelocity;
+    Vec2 mZoomAnchor;
+    bool mDragging;
+    Vec2d mDragPrevPan, mPanVelocity;
 };
 
 inline Camera::Camera()
@@ -51,11 +105,28 @@ inline Camera::Camera()
     , mWindowResized (false)
     , mWindowSize ({})
     , mViewport ({})
-    , cZoomMin (0.1f), cZoomMax (10.0f)
-    , mBasePan ({0.0f, 0.0f})
-    , mPan ({0.0f, 0.0f})
-    , mZoom (1.0f)
+    , mZoomMin (0.1), mZoomMax (10.0)
+    , mBasePan ({0.0, 0.0})
+    , mPan ({0.0, 0.0})
+    , mPanFloat ({0.0f, 0.0f})
+    , mZoom (1.0)
     , mAspect (1.0f)
+    , mTransformsDirty (true)
+    , mWindowToWorld ()
+    , mWorldToWindow ()
+    , mCullStats ({})
+    , mLastCullStats ({})
+    , cTimeStep (1.0f / 120.0f)
+    , cZoomStiffness (20.0f)
+    , cPanFriction (4.0f)
+    , cPanStopSpeed (0.01f)
+    , mTimeAccumulator (0.0f)
+    , mZoomTarget (1.0)
+    , mZoomVelocity (0.0)
+    , mZoomAnchor ({0.0f, 0.0f})
+    , mDragging (false)
+    , mDragPrevPan ({0.0, 0.0})
+    , mPanVelocity ({0.0, 0.0})
 {
     setWindowSize(640, 480);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 // Window and input event handling
 //
 #include <algorithm>
+#include <string.h>
 #include <SDL.h>
 #include <SDL_opengles2.h>
 #include "events.h"
@@ -42,38 +43,50 @@ void EventHandler::initWindow(const char* title)
 void EventHandler::swapWindow()
 {
     SDL_GL_SwapWindow(mpWindow);
+
+    // Time to first frame, what startup costs before anything is on screen
+    if (mStartCounter != 0)
+    {
+        printf("INFO: First frame after %.2f ms\n", (SDL_GetPerformanceCounter() - mStartCounter) * 1000.0 / SDL_GetPerformanceFrequency());
+        mStartCounter = 0;
+    }
+
+    // Track frame times for the replay report
+    if (mInputMode == InputMode::Replay)
+    {
+        Uint64 counter = SDL_GetPerformanceCounter();
+        if (mLastSwapCounter != 0)
+            mFrameTimes.push_back((counter - mLastSwapCounter) * 1000.0f / SDL_GetPerformanceFrequency());
+        mLastSwapCounter = counter;
+    }
 }
 
-void EventHandler::zoomEventMouse(bool mouseWheelDown, int x, int y)
-{                
-    float preZoomWorldX, preZoomWorldY;
-    mCamera.windowToWorldCoords(mMousePositionX, mMousePositionY, preZoomWorldX, preZoomWorldY);
+// Native idle frames sleep this long, about a frame, rather than spin
+const Uint32 cIdleFrameMs = 10;
 
-    // Zoom by scaling up/down in 0.05 increments 
-    float zoomDelta = mouseWheelDown ? -cMouseWheelZoomDelta : cMouseWheelZoomDelta;
-    mCamera.setZoomDelta(zoomDelta);
+void EventHandler::skipFrame()
+{
+    mStats.skippedFrames++;
+
+#ifndef __EMSCRIPTEN__
+    SDL_Delay(cIdleFrameMs);
+#endif
+}
 
-    // Zoom to point: Keep the world coords under mouse position the same before and after the zoom
-    float postZoomWorldX, postZoomWorldY;
-    mCamera.windowToWorldCoords(mMousePositionX, mMousePositionY, postZoomWorldX, postZoomWorldY);
-    Vec2 deltaWorld = { postZoomWorldX - preZoomWorldX, postZoomWorldY - preZoomWorldY };
-    mCamera.setPanDelta (deltaWorld);
+void EventHandler::zoomEventMouse(float wheelDelta, int x, int y)
+{                
+    // Zoom by a constant factor per wheel notch, scaled by wheel magnitude, to the point under the mouse
+    float deviceX, deviceY;
+    mCamera.windowToDeviceCoords(x, y, deviceX, deviceY);
+    mCamera.zoomToPoint(powf(cMouseWheelZoomFactor, wheelDelta), deviceX, deviceY);
 }
 
 void EventHandler::zoomEventPinch (float pinchDist, float pinchX, float pinchY)
 {
-    float preZoomWorldX, preZoomWorldY;
-    mCamera.normWindowToWorldCoords(pinchX, pinchY, preZoomWorldX, preZoomWorldY);
-
-    // Zoom in/out by positive/negative mPinch distance
-    float zoomDelta = pinchDist * cPinchScale;
-    mCamera.setZoomDelta(zoomDelta);
-
-    // Zoom to point: Keep the world coords under pinch position the same before and after the zoom
-    float postZoomWorldX, postZoomWorldY;
-    mCamera.normWindowToWorldCoords(pinchX, pinchY, postZoomWorldX, postZoomWorldY);
-    Vec2 deltaWorld = { postZoomWorldX - preZoomWorldX, postZoomWorldY - preZoomWorldY };
-    mCamera.setPanDelta (deltaWorld);
+    // Zoom in/out by positive/negative mPinch distance, to the point under the pinch
+    float deviceX, deviceY;
+    mCamera.normWindowToDeviceCoords(pinchX, pinchY, deviceX, deviceY);
+    mCamera.zoomToPoint(expf(pinchDist * cPinchScale), deviceX, deviceY);
 }
 
 void EventHandler::panEventMouse(int x, int y)
@@ -84,7 +97,7 @@ void EventHandler::panEventMouse(int x, int y)
     float deviceX, deviceY;
     mCamera.windowToDeviceCoords(deltaX,  deltaY, deviceX, deviceY);
 
-    Vec2 pan = { mCamera.basePan().x + deviceX / mCamera.zoom(), 
+    Vec2d pan = { mCamera.basePan().x + deviceX / mCamera.zoom(), 
                  mCamera.basePan().y + deviceY / mCamera.zoom() / mCamera.aspect() };
     mCamera.setPan(pan);
 }
@@ -97,131 +110,427 @@ void EventHandler::panEventFinger(float x, float y)
     float deviceX, deviceY;
     mCamera.normWindowToDeviceCoords(deltaX,  deltaY, deviceX, deviceY);
 
-    Vec2 pan = { mCamera.basePan().x + deviceX / mCamera.zoom(), 
+    Vec2d pan = { mCamera.basePan().x + deviceX / mCamera.zoom(), 
                  mCamera.basePan().y + deviceY / mCamera.zoom() / mCamera.aspect() };
     mCamera.setPan(pan);
 }
 
-void EventHandler::processEvents()
+// Apply motion, wheel and pinch input coalesced since the last flush
+void EventHandler::flushPendingInput()
 {
-    // Handle events
-    SDL_Event event;
-    while (SDL_PollEvent(&event))
+    if (mPending.mousePan)
+        panEventMouse(mPending.mouseX, mPending.mouseY);
+    if (mPending.fingerPan)
+        panEventFinger(mPending.fingerX, mPending.fingerY);
+    if (mPending.wheel != 0.0f)
+        zoomEventMouse(mPending.wheel, mMousePositionX, mMousePositionY);
+    if (mPending.pinch)
+        zoomEventPinch(mPending.pinchDist, mPending.pinchX, mPending.pinchY);
+
+    if (mPending.mousePan || mPending.fingerPan || mPending.wheel != 0.0f || mPending.pinch)
+        mStats.cameraUpdates++;
+    mPending = {};
+}
+
+void EventHandler::handleEvent(SDL_Event& event)
+{
+    mStats.events++;
+
+    // Pending motion must land before anything that changes pan state or window size
+    switch (event.type)
+    {
+        case SDL_WINDOWEVENT:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+        case SDL_FINGERDOWN:
+        case SDL_FINGERUP:
+            flushPendingInput();
+            break;
+    }
+
+    switch (event.type)
     {
-        switch (event.type)
+        case SDL_QUIT:
+            finishInput();
+            std::terminate();
+            break;
+
+        case SDL_WINDOWEVENT:
         {
-            case SDL_QUIT:
-                std::terminate();
-                break;
+            if (event.window.windowID == mWindowID
+                && event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+            {
+                int width = event.window.data1, height = event.window.data2;
+                windowResizeEvent(width, height);
+            }
+            break;
+        }
 
-            case SDL_WINDOWEVENT:
+        case SDL_MOUSEWHEEL: 
+        {
+            // SDL_MOUSEWHEEL regression? 
+            // m->y no longer reliable (often y is 0 when mouse wheel is spun up or down), use m->preciseY instead
+            SDL_MouseWheelEvent *m = (SDL_MouseWheelEvent*)&event;
+        	#ifdef EVENTS_DEBUG
+            	printf ("SDL_MOUSEWHEEL= x,y=%d,%d preciseX,preciseY=%f,%f\n", m->x, m->y, m->preciseX, m->preciseY);
+        	#endif
+        	mPending.wheel += m->preciseY;
+        	break;
+        }
+        
+        case SDL_MOUSEMOTION: 
+        {
+            SDL_MouseMotionEvent *m = (SDL_MouseMotionEvent*)&event;
+            mMousePositionX = m->x;
+            mMousePositionY = m->y;
+            if (mMouseButtonDown && !mFingerDown && !mPinch)
             {
-                if (event.window.windowID == mWindowID
-                    && event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
-                {
-                    int width = event.window.data1, height = event.window.data2;
-                    windowResizeEvent(width, height);
-                }
-                break;
+                mPending.mousePan = true;
+                mPending.mouseX = mMousePositionX;
+                mPending.mouseY = mMousePositionY;
             }
+            break;
+        }
 
-            case SDL_MOUSEWHEEL: 
+        case SDL_MOUSEBUTTONDOWN: 
+        {
+            SDL_MouseButtonEvent *m = (SDL_MouseButtonEvent*)&event;
+            if (m->button == SDL_BUTTON_LEFT && !mFingerDown && !mPinch)
             {
-                // SDL_MOUSEWHEEL regression? 
-                // m->y no longer reliable (often y is 0 when mouse wheel is spun up or down), use m->preciseY instead
-                SDL_MouseWheelEvent *m = (SDL_MouseWheelEvent*)&event;
-            	#ifdef EVENTS_DEBUG
-                	printf ("SDL_MOUSEWHEEL= x,y=%d,%d preciseX,preciseY=%f,%f\n", m->x, m->y, m->preciseX, m->preciseY);
-            	#endif
-            	bool mouseWheelDown = (m->preciseY < 0.0);
-            	zoomEventMouse(mouseWheelDown, mMousePositionX, mMousePositionY);
-            	break;
+                mMouseButtonDown = true;
+                mMouseButtonDownX = m->x;
+                mMouseButtonDownY = m->y;
+                mCamera.beginDrag();
             }
-            
-            case SDL_MOUSEMOTION: 
+            break;
+        }
+
+        case SDL_MOUSEBUTTONUP: 
+        {
+            SDL_MouseButtonEvent *m = (SDL_MouseButtonEvent*)&event;
+            if (m->button == SDL_BUTTON_LEFT && mMouseButtonDown)
             {
-                SDL_MouseMotionEvent *m = (SDL_MouseMotionEvent*)&event;
-                mMousePositionX = m->x;
-                mMousePositionY = m->y;
-                if (mMouseButtonDown && !mFingerDown && !mPinch)
-                    panEventMouse(mMousePositionX, mMousePositionY);
-                break;
+                mMouseButtonDown = false;
+                mCamera.endDrag(true);
             }
+            break;
+        }
 
-            case SDL_MOUSEBUTTONDOWN: 
+        case SDL_FINGERMOTION:
+            if (mFingerDown)
             {
-                SDL_MouseButtonEvent *m = (SDL_MouseButtonEvent*)&event;
-                if (m->button == SDL_BUTTON_LEFT && !mFingerDown && !mPinch)
+                SDL_TouchFingerEvent *m = (SDL_TouchFingerEvent*)&event;
+
+                // Finger down and finger moving must match
+                if (m->fingerId == mFingerDownId)
                 {
-                    mMouseButtonDown = true;
-                    mMouseButtonDownX = m->x;
-                    mMouseButtonDownY = m->y;
-                    mCamera.setBasePan();
+                    mPending.fingerPan = true;
+                    mPending.fingerX = m->x;
+                    mPending.fingerY = m->y;
                 }
-                break;
             }
+            break;
 
-            case SDL_MOUSEBUTTONUP: 
+        case SDL_FINGERDOWN:
+            if (!mPinch)
             {
-                SDL_MouseButtonEvent *m = (SDL_MouseButtonEvent*)&event;
-                if (m->button == SDL_BUTTON_LEFT)
-                    mMouseButtonDown = false;
-                break;
-            }
-
-            case SDL_FINGERMOTION:
+                // Finger already down means multiple fingers, which is handled by multigesture event
                 if (mFingerDown)
+                {
+                    mFingerDown = false;
+                    mCamera.endDrag(false);
+                }
+                else
                 {
                     SDL_TouchFingerEvent *m = (SDL_TouchFingerEvent*)&event;
 
-                    // Finger down and finger moving must match
-                    if (m->fingerId == mFingerDownId)
-                        panEventFinger(m->x, m->y);
+                    mFingerDown = true;
+                    mFingerDownX = m->x;
+                    mFingerDownY = m->y;
+                    mFingerDownId = m->fingerId;
+                    mCamera.beginDrag();
                 }
-                break;
+            }
+            break;
 
-            case SDL_FINGERDOWN:
-                if (!mPinch)
-                {
-                    // Finger already down means multiple fingers, which is handled by multigesture event
-                    if (mFingerDown)
-                        mFingerDown = false;
-                    else
-                    {
-                        SDL_TouchFingerEvent *m = (SDL_TouchFingerEvent*)&event;
-
-                        mFingerDown = true;
-                        mFingerDownX = m->x;
-                        mFingerDownY = m->y;
-                        mFingerDownId = m->fingerId;
-                        mCamera.setBasePan();
-                    }
-                }
+        case SDL_MULTIGESTURE:
+        {
+            SDL_MultiGestureEvent *m = (SDL_MultiGestureEvent*)&event;
+            if (m->numFingers == 2 && fabs(m->dDist) >= cPinchZoomThreshold)
+            {
+                mPinch = true;
+                mFingerDown = false;
+                mMouseButtonDown = false;
+                mPending.pinch = true;
+                mPending.pinchDist += m->dDist;
+                mPending.pinchX = m->x;
+                mPending.pinchY = m->y;
+            }
+            break;
+        }
+
+        case SDL_FINGERUP:
+            // Flick after a single finger pan, but not after a pinch
+            if (mFingerDown || mPinch)
+                mCamera.endDrag(mFingerDown);
+            mFingerDown = false;
+            mPinch = false;
+            break;
+    }
+
+    #ifdef EVENTS_DEBUG
+        printf ("event=%d mousePos=%d,%d mouseButtonDown=%d fingerDown=%d pinch=%d aspect=%f window=%dx%d\n", 
+                event.type, mMousePositionX, mMousePositionY, mMouseButtonDown, mFingerDown, mPinch, mCamera.aspect(), mCamera.windowSize().width, mCamera.windowSize().height);      
+        printf ("    zoom=%f pan=%f,%f\n", mCamera.zoom(), mCamera.pan()[0], mCamera.pan()[1]);
+    #endif
+}
+
+void EventHandler::processEvents()
+{
+    Uint64 startCounter = SDL_GetPerformanceCounter();
+
+    // Handle events
+    SDL_Event event;
+    while (pollEvent(event))
+        handleEvent(event);
+
+    flushPendingInput();
+
+    // Advance camera animation, by a fixed frame time when replaying recorded frames 1:1 so results are deterministic
+    Uint32 ticks = SDL_GetTicks();
+    float elapsedSeconds = (mInputMode == InputMode::Replay && mReplaySpeed == 0.0f) 
+                           ? 1.0f / 60.0f : (ticks - mLastFrameTicks) / 1000.0f;
+    mLastFrameTicks = ticks;
+    mCamera.animate(elapsedSeconds);
+
+    // Mark end of frame, so replay can reproduce the same per-frame event batches
+    if (mInputMode == InputMode::Record)
+        recordEvent(nullptr);
+
+    mStats.processMs += (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+//
+// Input recording & replay
+//
+// File format: "\377evr" file id, int version, then records of
+// Uint32 time (ms since recording start), Uint32 size, and size bytes of the SDL event.
+// A record with size 0 marks the end of a frame.
+//
+
+const char cRecordFileId[4] = {'\377', 'e', 'v', 'r'};
+const int cRecordFileVersion = 1;
+
+// Bytes of an SDL event that need to be recorded, or 0 for events the handler ignores
+static Uint32 recordedEventSize(Uint32 type)
+{
+    switch (type)
+    {
+        case SDL_QUIT: return sizeof(SDL_QuitEvent);
+        case SDL_WINDOWEVENT: return sizeof(SDL_WindowEvent);
+        case SDL_MOUSEWHEEL: return sizeof(SDL_MouseWheelEvent);
+        case SDL_MOUSEMOTION: return sizeof(SDL_MouseMotionEvent);
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP: return sizeof(SDL_MouseButtonEvent);
+        case SDL_FINGERMOTION:
+        case SDL_FINGERDOWN:
+        case SDL_FINGERUP: return sizeof(SDL_TouchFingerEvent);
+        case SDL_MULTIGESTURE: return sizeof(SDL_MultiGestureEvent);
+        default: return 0;
+    }
+}
+
+void EventHandler::parseArgs(int argc, char** argv)
+{
+    const char* recordFilename = nullptr;
+    const char* replayFilename = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool hasValue = (i + 1 < argc);
+        if (!strcmp(argv[i], "--record") && hasValue)
+            recordFilename = argv[++i];
+        else if (!strcmp(argv[i], "--replay") && hasValue)
+            replayFilename = argv[++i];
+        else if (!strcmp(argv[i], "--replay-speed") && hasValue)
+            mReplaySpeed = std::max(0.0f, (float)atof(argv[++i]));
+        else if (!strcmp(argv[i], "--report") && hasValue)
+            mReportFilename = argv[++i];
+        else if (!strcmp(argv[i], "--zoom-limits") && i + 2 < argc)
+        {
+            double zoomMin = atof(argv[i + 1]), zoomMax = atof(argv[i + 2]);
+            if (zoomMin > 0.0 && zoomMax >= zoomMin)
+                mCamera.setZoomLimits(zoomMin, zoomMax);
+            i += 2;
+        }
+    }
+
+    mInputStartTicks = mLastFrameTicks = SDL_GetTicks();
+    if (replayFilename && loadReplay(replayFilename))
+        mInputMode = InputMode::Replay;
+    else if (recordFilename && openRecording(recordFilename))
+        mInputMode = InputMode::Record;
+}
+
+bool EventHandler::openRecording(const char* filename)
+{
+    mpRecordFile = fopen(filename, "wb");
+    if (!mpRecordFile)
+    {
+        printf("ERROR: Could not open %s for recording\n", filename);
+        return false;
+    }
+
+    fwrite(cRecordFileId, 1, 4, mpRecordFile);
+    fwrite(&cRecordFileVersion, sizeof(int), 1, mpRecordFile);
+    printf("INFO: Recording input to %s\n", filename);
+    return true;
+}
+
+bool EventHandler::loadReplay(const char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+    {
+        printf("ERROR: Could not open %s for replay\n", filename);
+        return false;
+    }
+
+    char fileId[4];
+    int version = 0;
+    if (fread(fileId, 1, 4, file) != 4 || memcmp(fileId, cRecordFileId, 4)
+        || fread(&version, sizeof(int), 1, file) != 1 || version != cRecordFileVersion)
+    {
+        printf("ERROR: %s is not an input recording\n", filename);
+        fclose(file);
+        return false;
+    }
+
+    RecordedEvent recorded;
+    Uint32 size;
+    size_t frameEnds = 0;
+    while (fread(&recorded.time, sizeof(Uint32), 1, file) == 1 && fread(&size, sizeof(Uint32), 1, file) == 1)
+    {
+        memset(&recorded.event, 0, sizeof(SDL_Event));
+        recorded.frameEnd = (size == 0);
+        if (size > sizeof(SDL_Event) || (size > 0 && fread(&recorded.event, 1, size, file) != size))
+            break;
+        mReplayEvents.push_back(recorded);
+        frameEnds += recorded.frameEnd ? 1 : 0;
+    }
+    fclose(file);
+
+    // Frame times are recorded per swap; reserve them up front, with room for timed replays drawing extra frames,
+    // so replayed frames don't allocate
+    mFrameTimes.reserve(frameEnds * 2 + 1);
+
+    printf("INFO: Replaying %d input records from %s\n", (int)mReplayEvents.size(), filename);
+    return true;
+}
+
+// Append an event to the recording, or a frame end marker if event is null
+void EventHandler::recordEvent(const SDL_Event* event)
+{
+    Uint32 size = event ? recordedEventSize(event->type) : 0;
+    if (event && size == 0)
+        return;
+
+    Uint32 time = SDL_GetTicks() - mInputStartTicks;
+    fwrite(&time, sizeof(Uint32), 1, mpRecordFile);
+    fwrite(&size, sizeof(Uint32), 1, mpRecordFile);
+    if (size > 0)
+        fwrite(event, 1, size, mpRecordFile);
+}
+
+// Get the next event to handle: live events, recording them if enabled, or replayed events
+bool EventHandler::pollEvent(SDL_Event& event)
+{
+    while (SDL_PollEvent(&event))
+    {
+        if (mInputMode == InputMode::Record)
+            recordEvent(&event);
+
+        // During replay, only quit comes from the live event queue
+        if (mInputMode != InputMode::Replay || event.type == SDL_QUIT)
+            return true;
+    }
+
+    if (mInputMode == InputMode::Replay)
+    {
+        if (mReplayIndex >= mReplayEvents.size())
+        {
+            finishInput();
+            exit(0);
+        }
+
+        // Replay a recorded frame per frame, stopping at each frame end, or follow recorded timestamps scaled by
+        // replay speed, replaying every event that's due, across as many recorded frames as that covers
+        while (mReplayIndex < mReplayEvents.size())
+        {
+            const RecordedEvent& recorded = mReplayEvents[mReplayIndex];
+            if (mReplaySpeed != 0.0f && recorded.time > (SDL_GetTicks() - mInputStartTicks) * mReplaySpeed)
                 break;
 
-            case SDL_MULTIGESTURE:
+            mReplayIndex++;
+            if (!recorded.frameEnd)
             {
-                SDL_MultiGestureEvent *m = (SDL_MultiGestureEvent*)&event;
-                if (m->numFingers == 2 && fabs(m->dDist) >= cPinchZoomThreshold)
-                {
-                    mPinch = true;
-                    mFingerDown = false;
-                    mMouseButtonDown = false;
-                    zoomEventPinch(m->dDist, m->x, m->y);
-                }
-                break;
+                event = recorded.event;
+                return true;
             }
-
-            case SDL_FINGERUP:
-                mFingerDown = false;
-                mPinch = false;
+            if (mReplaySpeed == 0.0f)
                 break;
         }
+    }
+
+    return false;
+}
 
-        #ifdef EVENTS_DEBUG
-            printf ("event=%d mousePos=%d,%d mouseButtonDown=%d fingerDown=%d pinch=%d aspect=%f window=%dx%d\n", 
-                    event.type, mMousePositionX, mMousePositionY, mMouseButtonDown, mFingerDown, mPinch, mCamera.aspect(), mCamera.windowSize().width, mCamera.windowSize().height);      
-            printf ("    zoom=%f pan=%f,%f\n", mCamera.zoom(), mCamera.pan()[0], mCamera.pan()[1]);
-        #endif
+// Close the recording, or write the replay report
+void EventHandler::finishInput()
+{
+    if (mInputMode == InputMode::Record && mpRecordFile)
+    {
+        fclose(mpRecordFile);
+        mpRecordFile = nullptr;
     }
-}
\ No newline at end of file
+    else if (mInputMode == InputMode::Replay)
+        writeReport();
+
+    mInputMode = InputMode::Live;
+}
+
+void EventHandler::writeReport()
+{
+    std::vector<float> sorted(mFrameTimes);
+    std::sort(sorted.begin(), sorted.end());
+
+    int frames = (int)sorted.size();
+    float totalMs = 0.0f;
+    for (float ms : sorted)
+        totalMs += ms;
+    auto percentile = [&](float p) { return frames ? sorted[std::min(frames - 1, (int)(p * frames))] : 0.0f; };
+
+    char report[1536];
+    int length = snprintf(report, sizeof(report),
+                          "frames %d\n"
+                          "frame ms mean %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f\n"
+                          "events %u camera updates %u process events ms %.3f\n",
+                          frames,
+                          frames ? totalMs / frames : 0.0f, percentile(0.5f), percentile(0.95f), percentile(0.99f), percentile(1.0f),
+                          mStats.events, mStats.cameraUpdates, mStats.processMs);
+
+    // Sections the sample added, e.g. GL resources left at the end of the replay
+    for (ReportSection& section : mReportSections)
+        if (length >= 0 && length < (int)sizeof(report))
+            length += section(report + length, sizeof(report) - length);
+    printf("INFO: Replay report\n%s", report);
+
+    FILE* file = fopen(mReportFilename, "w");
+    if (file)
+    {
+        fputs(report, file);
+        fclose(file);
+    }
+    else
+        printf("ERROR: Could not write %s\n", mReportFilename);
+}
@@ -1,17 +1,40 @@
 //
 // Window and input event handling
 //
+#include <stdio.h>
+#include <functional>
+#include <vector>
 #include "camera.h"
 
 class EventHandler
 {
 public:
-    EventHandler(const char* windowTitle);
+    // Command line flags:
+    //     --record <file>        Record input events to a binary file
+    //     --replay <file>        Replay input events from a recorded file, then write a frame time report and exit
+    //     --replay-speed <x>     Replay at x times original speed, or 0 to replay recorded frames 1:1 (default)
+    //     --report <file>        Frame time report filename (default replay_report.txt)
+    //     --zoom-limits <min> <max>  Camera zoom range (default 0.1 to 10), e.g. 1e-3 1e9 for deep zooms
+    EventHandler(const char* windowTitle, int argc = 0, char** argv = nullptr);
 
     void processEvents();
     Camera& camera() { return mCamera; }
     void swapWindow();
 
+    // Idle frames: when idle() and a sample has nothing new to draw, it calls skipFrame() instead of drawing,
+    // leaving the last frame on screen. Never idle while replaying, so the replay report times every frame.
+    bool idle() { return mInputMode != InputMode::Replay && mCamera.settled(); }
+    void skipFrame();
+
+    // Per-frame input statistics, accumulated since the last resetStats()
+    struct Stats { unsigned int events, cameraUpdates, skippedFrames; double processMs; };
+    Stats& stats() { return mStats; }
+    void resetStats() { mStats = {}; }
+
+    // Appends lines to the replay report, returning the snprintf result (e.g. GLResource::writeReport)
+    typedef std::function<int(char* buffer, size_t size)> ReportSection;
+    void addReportSection(ReportSection section) { mReportSections.push_back(section); }
+
 private:
     // Camera
     Camera mCamera;
@@ -23,7 +46,7 @@ private:
     void initWindow(const char* title);
 
     // Mouse input
-    const float cMouseWheelZoomDelta;
+    const float cMouseWheelZoomFactor;
     bool mMouseButtonDown;
     int mMouseButtonDownX, mMouseButtonDownY;
     int mMousePositionX, mMousePositionY;
@@ -37,20 +60,57 @@ private:
     const float cPinchZoomThreshold, cPinchScale;
     bool mPinch;
 
+    // Coalesced input, applied once per frame (or before a button/finger state change)
+    struct PendingInput
+    {
+        bool mousePan; int mouseX, mouseY;
+        bool fingerPan; float fingerX, fingerY;
+        float wheel;
+        bool pinch; float pinchDist, pinchX, pinchY;
+    };
+    PendingInput mPending;
+    void flushPendingInput();
+
+    // Stats
+    Stats mStats;
+    Uint64 mStartCounter; // Window creation, until the first frame is swapped
+
+    // Input recording & replay
+    enum class InputMode { Live, Record, Replay };
+    struct RecordedEvent { Uint32 time; bool frameEnd; SDL_Event event; };
+    InputMode mInputMode;
+    FILE* mpRecordFile;
+    const char* mReportFilename;
+    float mReplaySpeed;
+    std::vector<RecordedEvent> mReplayEvents;
+    size_t mReplayIndex;
+    Uint32 mInputStartTicks, mLastFrameTicks;
+    Uint64 mLastSwapCounter;
+    std::vector<float> mFrameTimes;
+    std::vector<ReportSection> mReportSections;
+    void parseArgs(int argc, char** argv);
+    bool openRecording(const char* filename);
+    bool loadReplay(const char* filename);
+    void recordEvent(const SDL_Event* event);
+    bool pollEvent(SDL_Event& event);
+    void finishInput();
+    void writeReport();
+
     // Events
-    void zoomEventMouse(bool mouseWheelDown, int x, int y);
+    void zoomEventMouse(float wheelDelta, int x, int y);
     void zoomEventPinch (float pinchDist, float pinchX, float pinchY);
     void panEventMouse(int x, int y);
     void panEventFinger(float x, float y);
+    void handleEvent(SDL_Event& event);
 };
 
-inline EventHandler::EventHandler(const char* windowTitle)
+inline EventHandler::EventHandler(const char* windowTitle, int argc, char** argv)
     // Window
     : mpWindow (nullptr)
     , mWindowID (0)
  
     // Mouse input
-    , cMouseWheelZoomDelta (0.05f)
+    , cMouseWheelZoomFactor (1.1f)
     , mMouseButtonDown (false)
     , mMouseButtonDownX (0), mMouseButtonDownY (0)
     , mMousePositionX (0), mMousePositionY (0)
@@ -64,6 +124,21 @@ inline EventHandler::EventHandler(const char* windowTitle)
     , cPinchZoomThreshold (0.001f)
     , cPinchScale (8.0f)
     , mPinch (false)
+
+    // Coalesced input & stats
+    , mPending ({})
+    , mStats ({})
+    , mStartCounter (SDL_GetPerformanceCounter())
+
+    // Input recording & replay
+    , mInputMode (InputMode::Live)
+    , mpRecordFile (nullptr)
+    , mReportFilename ("replay_report.txt")
+    , mReplaySpeed (0.0f)
+    , mReplayIndex (0)
+    , mInputStartTicks (0), mLastFrameTicks (0)
+    , mLastSwapCounter (0)
 {
     initWindow(windowTitle);
+    parseArgs(argc, argv);
 }
\ No newline at end of file
@@ -0,0 +1,235 @@
+//
+// GL resources - move-only owners of GL buffers, textures, shaders and programs, with live count and byte accounting
+//
+#include <algorithm>
+#include <stdio.h>
+#include <SDL_opengles2.h>
+#include "glresource.h"
+
+// #define GLRESOURCE_DEBUG
+
+static GLResource::Stats resourceStats[GLResource::TypeCount] = {};
+static const char* resourceTypeNames[GLResource::TypeCount] = {"buffers", "textures", "shaders", "programs"};
+
+const GLResource::Stats& GLResource::stats(Type type)
+{
+    return resourceStats[type];
+}
+
+void GLResource::printReport(const char* label)
+{
+    printf("INFO: GL resources %s:\n", label);
+    for (int type = 0; type < TypeCount; ++type)
+    {
+        const Stats& stats = resourceStats[type];
+        printf("INFO:   %-8s live %d (peak %d, created %d), %.1f KB (peak %.1f KB)\n", resourceTypeNames[type], 
+               stats.live, stats.peakLive, stats.created, stats.bytes / 1024.0, stats.peakBytes / 1024.0);
+    }
+}
+
+int GLResource::writeReport(char* buffer, size_t size)
+{
+    // GL resources left at the end of the replay, and their peaks, to catch leaks across a session
+    const Stats& buffers = resourceStats[Buffer];
+    const Stats& textures = resourceStats[Texture];
+    const Stats& programs = resourceStats[Program];
+    return snprintf(buffer, size,
+                    "gl buffers live %d peak %d KB %.1f peak %.1f\n"
+                    "gl textures live %d peak %d KB %.1f peak %.1f\n"
+                    "gl programs live %d peak %d shaders live %d\n",
+                    buffers.live, buffers.peakLive, buffers.bytes / 1024.0, buffers.peakBytes / 1024.0,
+                    textures.live, textures.peakLive, textures.bytes / 1024.0, textures.peakBytes / 1024.0,
+                    programs.live, programs.peakLive, resourceStats[Shader].live);
+}
+
+GLResource::GLResource(Type type, GLuint id)
+    : mType (type)
+    , mId (id)
+    , mBytes (0)
+{
+    if (mId != 0)
+    {
+        Stats& stats = resourceStats[mType];
+        stats.live++;
+        stats.created++;
+        stats.peakLive = std::max(stats.peakLive, stats.live);
+
+        #ifdef GLRESOURCE_DEBUG
+            printf("created %s %u, %d live\n", resourceTypeNames[mType], mId, stats.live);
+        #endif
+    }
+}
+
+GLResource::GLResource(GLResource&& other)
+    : mType (other.mType)
+    , mId (other.mId)
+    , mBytes (other.mBytes)
+{
+    other.mId = 0;
+    other.mBytes = 0;
+}
+
+GLResource& GLResource::operator=(GLResource&& other)
+{
+    if (this != &other)
+    {
+        reset();
+        mId = other.mId;
+        mBytes = other.mBytes;
+        other.mId = 0;
+        other.mBytes = 0;
+    }
+    return *this;
+}
+
+GLResource::~GLResource()
+{
+    reset();
+}
+
+void GLResource::reset()
+{
+    if (mId == 0)
+        return;
+
+    switch (mType)
+    {
+        case Buffer: glDeleteBuffers(1, &mId); break;
+        case Texture: glDeleteTextures(1, &mId); break;
+        case Shader: glDeleteShader(mId); break;
+        case Program: glDeleteProgram(mId); break;
+        default: break;
+    }
+
+    setBytes(0);
+    resourceStats[mType].live--;
+
+    #ifdef GLRESOURCE_DEBUG
+        printf("deleted %s %u, %d live\n", resourceTypeNames[mType], mId, resourceStats[mType].live);
+    #endif
+    mId = 0;
+}
+
+void GLResource::setBytes(size_t bytes)
+{
+    Stats& stats = resourceStats[mType];
+    stats.bytes = stats.bytes - mBytes + bytes;
+    stats.peakBytes = std::max(stats.peakBytes, stats.bytes);
+    mBytes = bytes;
+}
+
+GLBuffer GLBuffer::create()
+{
+    GLuint id = 0;
+    glGenBuffers(1, &id);
+    return GLBuffer(id);
+}
+
+void GLBuffer::data(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+    glBindBuffer(target, mId);
+    glBufferData(target, size, data, usage);
+    setBytes(size);
+}
+
+GLTexture GLTexture::create()
+{
+    GLuint id = 0;
+    glGenTextures(1, &id);
+    return GLTexture(id);
+}
+
+static size_t bytesPerPixel(GLenum format, GLenum type)
+{
+    if (type == GL_UNSIGNED_SHORT_5_6_5 || type == GL_UNSIGNED_SHORT_4_4_4_4 || type == GL_UNSIGNED_SHORT_5_5_5_1)
+        return 2;
+
+    switch (format)
+    {
+        case GL_RGBA: return 4;
+        case GL_RGB: return 3;
+        case GL_LUMINANCE_ALPHA: return 2;
+        default: return 1; // GL_ALPHA, GL_LUMINANCE
+    }
+}
+
+static GLsizei nextPowerOfTwo(GLsizei value)
+{
+    GLsizei power = 1;
+    while (power < value)
+        power *= 2;
+    return power;
+}
+
+void GLTexture::image2D(GLint level, GLenum format, GLsizei width, GLsizei height, GLenum type, const void* pixels)
+{
+    glBindTexture(GL_TEXTURE_2D, mId);
+    glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, format, type, pixels);
+
+    size_t pixelBytes = bytesPerPixel(format, type);
+    setLevelBytes(level, (size_t)width * height * pixelBytes,
+                  (size_t)nextPowerOfTwo(width) * nextPowerOfTwo(height) * pixelBytes);
+}
+
+void GLTexture::compressedImage2D(GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei imageSize,
+                                  const void* data)
+{
+    glBindTexture(GL_TEXTURE_2D, mId);
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, imageSize, data);
+
+    // Block formats store whole 4x4 blocks, so pad in blocks
+    size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+    size_t paddedBlocks = (size_t)((nextPowerOfTwo(width) + 3) / 4) * ((nextPowerOfTwo(height) + 3) / 4);
+    setLevelBytes(level, imageSize, blocks ? imageSize / blocks * paddedBlocks : 0);
+}
+
+void GLTexture::setLevelBytes(GLint level, size_t levelBytes, size_t levelPaddedBytes)
+{
+    if (mBytes == 0)
+    {
+        for (int i = 0; i < cMaxLevels; ++i)
+            mLevelBytes[i] = mLevelPaddedBytes[i] = 0;
+        mPaddedBytes = 0;
+    }
+
+    if (level >= 0 && level < cMaxLevels)
+    {
+        // Re-uploading a level replaces its storage
+        size_t bytes = mBytes - mLevelBytes[level];
+        mLevelBytes[level] = levelBytes;
+        setBytes(bytes + mLevelBytes[level]);
+
+        mPaddedBytes -= mLevelPaddedBytes[level];
+        mLevelPaddedBytes[level] = levelPaddedBytes;
+        mPaddedBytes += mLevelPaddedBytes[level];
+    }
+}
+
+void GLTexture::subImage2D(GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type,
+                           const void* pixels)
+{
+    glBindTexture(GL_TEXTURE_2D, mId);
+    glTexSubImage2D(GL_TEXTURE_2D, level, x, y, width, height, format, type, pixels);
+}
+
+GLShader GLShader::compile(GLenum type, const GLchar* source)
+{
+    GLShader shader(glCreateShader(type));
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled)
+    {
+        GLchar log[1024] = "";
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        printf("ERROR: %s shader failed to compile: %s\n", type == GL_VERTEX_SHADER ? "Vertex" : "Fragment", log);
+    }
+    return shader;
+}
+
+GLProgram GLProgram::create()
+{
+    return GLProgram(glCreateProgram());
+}
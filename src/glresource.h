@@ -0,0 +1,108 @@
+//
+// GL resources - move-only owners of GL buffers, textures, shaders and programs, with live count and byte accounting
+//
+// Requires SDL_opengles2.h to be included first.
+//
+#pragma once
+#include <stddef.h>
+
+class GLResource
+{
+public:
+    enum Type { Buffer, Texture, Shader, Program, TypeCount };
+
+    // Per type accounting, over all resources of the type. Bytes are what was uploaded (textures include mip levels).
+    struct Stats { int live, peakLive, created; size_t bytes, peakBytes; };
+    static const Stats& stats(Type type);
+    static void printReport(const char* label);
+    static int writeReport(char* buffer, size_t size); // Replay report lines, see EventHandler::addReportSection
+
+    // Converts to the GL name, so wrapped resources can be passed straight to GL calls
+    GLuint id() const { return mId; }
+    operator GLuint() const { return mId; }
+    size_t bytes() const { return mBytes; }
+
+    // Delete the GL object now
+    void reset();
+
+protected:
+    GLResource(Type type, GLuint id);
+    GLResource(GLResource&& other);
+    GLResource& operator=(GLResource&& other);
+    ~GLResource();
+    GLResource(const GLResource&) = delete;
+    GLResource& operator=(const GLResource&) = delete;
+
+    void setBytes(size_t bytes);
+
+    Type mType;
+    GLuint mId;
+    size_t mBytes;
+};
+
+class GLBuffer : public GLResource
+{
+public:
+    GLBuffer() : GLResource(Buffer, 0) {}
+    static GLBuffer create();
+
+    // Bind to target and (re)allocate its storage, like glBufferData
+    void data(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+
+private:
+    GLBuffer(GLuint id) : GLResource(Buffer, id) {}
+};
+
+class GLTexture : public GLResource
+{
+public:
+    GLTexture() : GLResource(Texture, 0), mPaddedBytes (0) {}
+    static GLTexture create();
+
+    // Take ownership of an existing texture name
+    static GLTexture adopt(GLuint id) { return GLTexture(id); }
+
+    // Bind to GL_TEXTURE_2D and upload a level, like glTexImage2D
+    void image2D(GLint level, GLenum format, GLsizei width, GLsizei height, GLenum type, const void* pixels);
+
+    // Bind to GL_TEXTURE_2D and upload a level of a block compressed format, like glCompressedTexImage2D
+    void compressedImage2D(GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei imageSize,
+                           const void* data);
+
+    // Bind to GL_TEXTURE_2D and update part of an uploaded level, like glTexSubImage2D
+    void subImage2D(GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels);
+
+    // Bytes as if each level were padded to power of two dimensions, as some GPUs allocate them
+    size_t paddedBytes() const { return mBytes ? mPaddedBytes : 0; }
+
+private:
+    GLTexture(GLuint id) : GLResource(Texture, id), mLevelBytes {}, mLevelPaddedBytes {}, mPaddedBytes (0) {}
+    void setLevelBytes(GLint level, size_t bytes, size_t paddedBytes);
+
+    static const int cMaxLevels = 16;
+    size_t mLevelBytes[cMaxLevels], mLevelPaddedBytes[cMaxLevels];
+    size_t mPaddedBytes;
+};
+
+class GLShader : public GLResource
+{
+public:
+    GLShader() : GLResource(Shader, 0) {}
+
+    // Create and compile, printing the info log if compilation fails
+    static GLShader compile(GLenum type, const GLchar* source);
+
+private:
+    GLShader(GLuint id) : GLResource(Shader, id) {}
+};
+
+class GLProgram : public GLResource
+{
+public:
+    GLProgram() : GLResource(Program, 0) {}
+
+    static GLProgram create();
+
+private:
+    GLProgram(GLuint id) : GLResource(Program, id) {}
+};
@@ -0,0 +1,41 @@
+//
+// Heap counter - counts global operator new calls, so steady state frames can be checked for heap allocations
+//
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include "heapcount.h"
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+
+static std::atomic<unsigned int> sAllocations(0);
+
+static void* countedAllocate(size_t size)
+{
+    sAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size) { return countedAllocate(size); }
+void* operator new[](size_t size) { return countedAllocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { sAllocations.fetch_add(1, std::memory_order_relaxed); return malloc(size ? size : 1); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { sAllocations.fetch_add(1, std::memory_order_relaxed); return malloc(size ? size : 1); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+
+bool HeapCounter::enabled() { return true; }
+unsigned int HeapCounter::allocations() { return sAllocations.load(std::memory_order_relaxed); }
+
+#else
+
+bool HeapCounter::enabled() { return false; }
+unsigned int HeapCounter::allocations() { return 0; }
+
+#endif
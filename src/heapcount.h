@@ -0,0 +1,17 @@
+//
+// Heap counter - counts global operator new calls, so steady state frames can be checked for heap allocations
+//
+// Counting replaces the global operator new and delete, so it's only compiled in with -DCOUNT_HEAP_ALLOCATIONS,
+// e.g. for replay or test builds. C allocations through malloc aren't counted; the frame arena counts its own overflows.
+//
+#pragma once
+
+class HeapCounter
+{
+public:
+    // False unless built with -DCOUNT_HEAP_ALLOCATIONS, in which case allocations() is always 0
+    static bool enabled();
+
+    // operator new calls on all threads since startup
+    static unsigned int allocations();
+};
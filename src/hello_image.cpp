@@ -5,11 +5,20 @@
 //     Install emscripten: http://kripken.github.io/emscripten-site/docs/getting_started/downloads.html
 //
 // Build:
-//     emcc -std=c++11 hello_image.cpp events.cpp camera.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s FULL_ES2=1 -s WASM=1 -o ../hello_image.js
+//     emcc -std=c++11 hello_image.cpp events.cpp camera.cpp threadpool.cpp arena.cpp glresource.cpp texturemanager.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s FULL_ES2=1 -s WASM=1 -o ../hello_image.js
+//
+// Build with worker threads, one pthread per core (the build above runs the thread pool inline on the main thread):
+//     emcc -std=c++11 -pthread hello_image.cpp events.cpp camera.cpp threadpool.cpp arena.cpp glresource.cpp texturemanager.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s FULL_ES2=1 -s WASM=1 -s USE_PTHREADS=1 -s PTHREAD_POOL_SIZE=navigator.hardwareConcurrency -s ALLOW_MEMORY_GROWTH=1 -o ../hello_image_pthreads.html
 // 
 // Run:
 //     emrun hello_image.html
 //
+//     The pthreads build needs SharedArrayBuffer, so serve it cross-origin isolated (emrun does).
+//
+// Options:
+//     --threads <count>    Threads used to generate the background image (default one per core), to measure scaling
+//     --thread-sweep       Time generating a 2048x2048 image on 1 thread up to one per core, printing the speedup of each
+//
 // Result:
 //     A background image and a colorful triangle.  Left mouse pans, mouse wheel zooms in/out.
 //
@@ -18,27 +27,36 @@
 #include <emscripten.h>
 #endif
 
+#include <algorithm>
+#include <vector>
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_opengles2.h>
 
 #include "events.h"
+#include "threadpool.h"
+#include "arena.h"
+#include "glresource.h"
+#include "texturemanager.h"
 
 // Geometry
-GLuint triangleVbo = 0;
-GLuint quadVbo = 0;
+GLBuffer triangleVbo;
+const double triangleWorld[] = { 0.0, 0.5,  -0.5, -0.5,  0.5, -0.5 }; // Uploaded relative to the eye by updateGeometry()
+const WorldRect triangleBounds = {-0.5, -0.5, 0.5, 0.5};
+bool sceneChanged = true; // Since the last frame drawn, other than by the camera
+GLBuffer quadVbo;
 
-// Texture
-SDL_Surface* bgImageTexture = nullptr;
-GLuint textureObj = 0;
+// Texture, regenerated by the texture manager if evicted
+GLTexture textureObj;
+int textureHandle = -1;
 
 // Shader vars
 const GLint positionAttrib = 0;
-GLint shaderPan, shaderZoom, shaderAspect, shaderViewport, shaderImageSize, shaderTexSize;
+GLint shaderZoom, shaderAspect, shaderViewport, shaderImageSize, shaderTexSize;
 GLfloat imageSize[2] = {0.0f, 0.0f}, texSize[2] = {0.0f, 0.0f};
 
 // Image quad vertex & fragment shaders
-GLuint quadShaderProgram = 0;
+GLProgram quadShaderProgram;
 const GLchar* quadVertexSource =
     "attribute vec4 position;                                   \n"
     "varying vec2 texCoord;                                     \n"
@@ -76,9 +94,8 @@ const GLchar* quadFragmentSource =
     "}                                                          \n";
 
 // Colorful triangle vertex & fragment shaders
-GLuint triShaderProgram = 0;
+GLProgram triShaderProgram;
 const GLchar* triVertexSource =
-    "uniform vec2 pan;                             \n"
     "uniform float zoom;                           \n"
     "uniform float aspect;                         \n"
     "attribute vec4 position;                      \n"
@@ -86,7 +103,6 @@ const GLchar* triVertexSource =
     "void main()                                   \n"
     "{                                             \n"
     "    gl_Position = vec4(position.xyz, 1.0);    \n"
-    "    gl_Position.xy += pan;                    \n"
     "    gl_Position.xy *= zoom;                   \n"
     "    gl_Position.y *= aspect;                  \n"
     "    color = gl_Position.xyz + vec3(0.5);      \n"
@@ -110,25 +126,20 @@ void updateShader(EventHandler& eventHandler)
     glUniform2fv(shaderTexSize, 1, texSize);
 
     glUseProgram(triShaderProgram);
-    glUniform2fv(shaderPan, 1, camera.pan());
     glUniform1f(shaderZoom, camera.zoom()); 
     glUniform1f(shaderAspect, camera.aspect());
 }
 
-GLuint initShader(const GLchar* vertexSource, const GLchar* fragmentSource)
+GLProgram initShader(const GLchar* vertexSource, const GLchar* fragmentSource)
 {
     // Create and compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
-    glCompileShader(vertexShader);
+    GLShader vertexShader = GLShader::compile(GL_VERTEX_SHADER, vertexSource);
 
     // Create and compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-    glCompileShader(fragmentShader);
+    GLShader fragmentShader = GLShader::compile(GL_FRAGMENT_SHADER, fragmentSource);
 
-    // Link vertex and fragment shader into shader program
-    GLuint shaderProgram = glCreateProgram();
+    // Link vertex and fragment shader into shader program.  The shaders are deleted on return, once linked.
+    GLProgram shaderProgram = GLProgram::create();
     glAttachShader(shaderProgram, vertexShader);
     glAttachShader(shaderProgram, fragmentShader);
     glBindAttribLocation(shaderProgram, positionAttrib, "position");
@@ -149,18 +160,25 @@ void initShaders(EventHandler& eventHandler)
     shaderImageSize = glGetUniformLocation(quadShaderProgram, "imageSize");
     shaderTexSize = glGetUniformLocation(quadShaderProgram, "texSize");
 
-    shaderPan = glGetUniformLocation(triShaderProgram, "pan");
     shaderZoom = glGetUniformLocation(triShaderProgram, "zoom");    
     shaderAspect = glGetUniformLocation(triShaderProgram, "aspect");
     
     updateShader(eventHandler);
 }
 
-void initGeometry()
+void updateGeometry(EventHandler& eventHandler)
+{
+    // Rebase the triangle's world coords relative to the eye and copy them into its vertex buffer
+    GLfloat vertices[sizeof(triangleWorld) / sizeof(double)];
+    eventHandler.camera().worldToEyeRelative(triangleWorld, vertices, 3);
+    glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+}
+
+void initGeometry(EventHandler& eventHandler)
 {
    // Create vertex buffer objects and copy vertex data into them
-    glGenBuffers(1, &quadVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVbo);
+    quadVbo = GLBuffer::create();
     GLfloat quadVertices[] = 
     {
         0.0f, 1.0f, 0.0f,
@@ -168,17 +186,11 @@ void initGeometry()
         0.0f, 0.0f, 0.0f,
         1.0f, 0.0f, 0.0f
     };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    quadVbo.data(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
 
-    glGenBuffers(1, &triangleVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
-    GLfloat triangleVertices[] = 
-    {
-        0.0f, 0.5f, 0.0f,
-        -0.5f, -0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f
-    };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(triangleVertices), triangleVertices, GL_STATIC_DRAW);  
+    triangleVbo = GLBuffer::create();
+    triangleVbo.data(GL_ARRAY_BUFFER, sizeof(triangleWorld) / sizeof(double) * sizeof(GLfloat), nullptr, GL_DYNAMIC_DRAW);
+    updateGeometry(eventHandler);
  }
 
 int min(int x, int y)
@@ -194,21 +206,67 @@ int nextPowerOfTwo(int val)
     return power;
 }
 
-void freeTexture()
+// Checkerboard with a yellow border, rows generated in parallel on pool, into pixels with rows of pitch pixels
+void generateImage(ThreadPool& pool, unsigned int* pixels, int pitch, int imageWidth, int imageHeight)
 {
-    // Free existing SDL image and GL texture
-    if (bgImageTexture)
+    pool.parallelFor(0, imageHeight, 16, [=](int rowBegin, int rowEnd)
     {
-        SDL_FreeSurface (bgImageTexture);
-        bgImageTexture = nullptr;
-    }
-    if (textureObj > 0)
+        for (int y = rowBegin; y < rowEnd; ++y)
+            for (int x = 0; x < imageWidth; ++x)
+            {
+                const int i = x+y*pitch;
+                if (y == 0 || x == 0 || y == imageHeight-1 || x == imageWidth - 1)
+                    pixels[i] = 0xff00ffff; // yellow
+                else 
+                {
+                    const int checkerSize = 100, halfChecker = checkerSize / 2,
+                            yMod = y % checkerSize, xMod = x % checkerSize;
+                    if ((yMod < halfChecker && xMod < halfChecker) 
+                        || (yMod >= halfChecker && xMod >= halfChecker))
+                        pixels[i] = 0xffc4c4c4; // light grey
+                    else
+                        pixels[i] = 0xff808080; // dark grey
+                }
+            }
+    });
+}
+
+// Time image generation on pools of 1 thread up to one per core, each against the single thread time
+void sweepThreads()
+{
+    const int imageSize = 2048, repeats = 10;
+    std::vector<unsigned int> pixels(imageSize * imageSize);
+
+#ifdef THREADPOOL_THREADS
+    const int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+#else
+    const int maxThreads = 1;
+    printf("INFO: Built without threads, sweeping 1 thread only\n");
+#endif
+    double singleThreadMs = 0.0;
+    for (int threadCount = 1; threadCount <= maxThreads; ++threadCount)
     {
-        glDeleteTextures(1, &textureObj);
-        textureObj = 0;
+        ThreadPool pool(threadCount - 1);
+        generateImage(pool, pixels.data(), imageSize, imageSize, imageSize); // Warm up the workers
+
+        Uint64 startCounter = SDL_GetPerformanceCounter();
+        for (int i = 0; i < repeats; ++i)
+            generateImage(pool, pixels.data(), imageSize, imageSize, imageSize);
+        double ms = (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency() / repeats;
+        if (threadCount == 1)
+            singleThreadMs = ms;
+
+        printf("INFO: Thread sweep %dx%d image on %2d threads in %7.2f ms, speedup %.2fx\n", 
+               imageSize, imageSize, threadCount, ms, ms > 0.0 ? singleThreadMs / ms : 0.0);
     }
 }
 
+void freeTexture()
+{
+    // Free existing GL texture
+    textureObj.reset();
+}
+
 void initTexture(EventHandler& eventHandler)
 {
     freeTexture();
@@ -235,44 +293,29 @@ void initTexture(EventHandler& eventHandler)
         imageHeight = min(winHeight, maxTextureSize);
     printf("INFO: window size=%dx%d  image size=%dx%d\n", winWidth, winHeight, imageWidth, imageHeight);
 
-    SDL_Surface* bgImage = SDL_CreateRGBSurface(0, imageWidth, imageHeight, bitsPerPixel, 0, 0, 0, 0);
-
-    unsigned int* bgImagePixels = (unsigned int*)bgImage->pixels;
-    for (int y = 0; y < bgImage->h; ++y)
-        for (int x = 0; x < bgImage->w; ++x)
-        {
-            const int i = x+y*bgImage->w;
-            if (y == 0 || x == 0 || y == bgImage->h-1 || x == bgImage->w - 1)
-                bgImagePixels[i] = 0xff00ffff; // yellow
-            else 
-            {
-                const int checkerSize = 100, halfChecker = checkerSize / 2,
-                        yMod = y % checkerSize, xMod = x % checkerSize;
-                if ((yMod < halfChecker && xMod < halfChecker) 
-                    || (yMod >= halfChecker && xMod >= halfChecker))
-                    bgImagePixels[i] = 0xffc4c4c4; // light grey
-                else
-                    bgImagePixels[i] = 0xff808080; // dark grey
-            }
-        }
-
     // OpenGLES requires power of 2 dimension textures, so create the smallest
-    // power of 2 image that fits the background image, along with 1 texel border
-    int texWidth = nextPowerOfTwo(bgImage->w + 2),
-        texHeight = nextPowerOfTwo(bgImage->h + 2);
-    bgImageTexture = SDL_CreateRGBSurface(0, texWidth, texHeight, bitsPerPixel, 0, 0, 0, 0);
-
-    // Clear the image and copy the background image into it, centered
-    unsigned int* texPixels = (unsigned int*)bgImageTexture->pixels;
-    memset(texPixels, 0x0, bgImageTexture->w * bgImageTexture->h * bgImageTexture->format->BytesPerPixel);
-    SDL_Rect destRect = {1, bgImageTexture->h - bgImage->h - 1, bgImage->w + 1, bgImageTexture->h - 1};
-    SDL_BlitSurface(bgImage, NULL, bgImageTexture, &destRect);
+    // power of 2 image that fits the background image, along with 1 texel border.
+    // It's only needed until uploaded, so it comes from frame scratch memory rather than the heap.
+    int texWidth = nextPowerOfTwo(imageWidth + 2),
+        texHeight = nextPowerOfTwo(imageHeight + 2);
+    ScratchScope scratch;
+    unsigned int* texPixels = scratch.allocate<unsigned int>(texWidth * texHeight);
+
+    // Clear the image and generate the background image into it, 1 texel in from its top left
+    memset(texPixels, 0x0, texWidth * texHeight * bitsPerPixel / 8);
+    unsigned int* bgImagePixels = texPixels + (texHeight - imageHeight - 1) * texWidth + 1;
+
+    // Generate checkerboard rows in parallel
+    Uint64 startCounter = SDL_GetPerformanceCounter();
+    generateImage(ThreadPool::shared(), bgImagePixels, texWidth, imageWidth, imageHeight);
+    printf("INFO: image generated in %.2f ms on %d threads\n", 
+           (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency(), ThreadPool::shared().threadCount());
     
     // Build GL texture
     //
 
     // Generate a GL texture object and bind it as current
-    glGenTextures(1, &textureObj);
+    textureObj = GLTexture::create();
     glBindTexture(GL_TEXTURE_2D, textureObj);
 
     // Set the GL texture's wrapping and stretching properties
@@ -281,30 +324,26 @@ void initTexture(EventHandler& eventHandler)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    // Upload SDL image to GL texture
-    GLint level = 0, border = 0;
-    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 
-                 bgImageTexture->w, bgImageTexture->h, 
-                 border, GL_RGBA, GL_UNSIGNED_BYTE, bgImageTexture->pixels);
+    // Upload image to GL texture
+    GLint level = 0;
+    textureObj.image2D(level, GL_RGBA, texWidth, texHeight, GL_UNSIGNED_BYTE, texPixels);
 
     // Check for errors
     GLenum glError = glGetError();
     if (glError != GL_NO_ERROR)
-        printf("ERROR: Texture %d (%dx%d) not built, error code %d\n", textureObj, bgImageTexture->w, bgImageTexture->h, glError);
+        printf("ERROR: Texture %d (%dx%d) not built, error code %d\n", textureObj.id(), texWidth, texHeight, glError);
     else
-        printf("OK: Texture %d (%dx%d) built.\n", textureObj, bgImageTexture->w, bgImageTexture->h);
+        printf("OK: Texture %d (%dx%d) built.\n", textureObj.id(), texWidth, texHeight);
 
     // Unbind texture
     glBindTexture(GL_TEXTURE_2D, 0);
 
     // Update quad shader
-    imageSize[0] = (GLfloat)bgImage->w + 2;
-    imageSize[1] = (GLfloat)bgImage->h + 2;
-    texSize[0] = (GLfloat)bgImageTexture->w;
-    texSize[1] = (GLfloat)bgImageTexture->h;
+    imageSize[0] = (GLfloat)imageWidth + 2;
+    imageSize[1] = (GLfloat)imageHeight + 2;
+    texSize[0] = (GLfloat)texWidth;
+    texSize[1] = (GLfloat)texHeight;
     updateShader(eventHandler);
-
-    SDL_FreeSurface (bgImage); 
 }
 
 void redraw(EventHandler& eventHandler)
@@ -316,7 +355,7 @@ void redraw(EventHandler& eventHandler)
     glClear(GL_COLOR_BUFFER_BIT);
 
     // Draw the background quad VBO with texture bound and image texture shader
-    glBindTexture(GL_TEXTURE_2D, textureObj);
+    glBindTexture(GL_TEXTURE_2D, TextureManager::shared().use(textureHandle));
     glUseProgram(quadShaderProgram);
     glBindBuffer(GL_ARRAY_BUFFER, quadVbo);
     glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
@@ -325,13 +364,19 @@ void redraw(EventHandler& eventHandler)
 
     // Draw the foreground triangle VBO with a colorful shader
     // No depth buffering here - triangle is in front by virtue of being drawn after quad
-    glUseProgram(triShaderProgram);
-    glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
-    glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    // Skip it if culled, i.e. panned or zoomed out of view
+    if (eventHandler.camera().isVisible(triangleBounds))
+    {
+        glUseProgram(triShaderProgram);
+        glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
+        glVertexAttribPointer(positionAttrib, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
     
-    // Swap front/back framebuffers
+    // Swap front/back framebuffers, publish this frame's culling counts, then evict textures not drawn this frame if over budget
     eventHandler.swapWindow();
+    eventHandler.camera().endCullFrame();
+    TextureManager::shared().endFrame();
 }
 
 void mainLoop(void* mainLoopArg) 
@@ -341,23 +386,58 @@ void mainLoop(void* mainLoopArg)
 
     // Re-initialize texture if window resized
     if (eventHandler.camera().windowResized())
-        initTexture(eventHandler);
+    {
+        TextureManager::shared().reload(textureHandle);
+        GLResource::printReport("after resize");
+        TextureManager::shared().printReport("after resize");
+    }
 
-    // Update shader if camera changed
-    if (eventHandler.camera().updated())
+    // Update shader and geometry if camera changed
+    bool cameraUpdated = eventHandler.camera().updated();
+    if (cameraUpdated)
+    {
         updateShader(eventHandler);
+        updateGeometry(eventHandler);
+    }
 
-    redraw(eventHandler);
+    // Nothing moved, so the last frame drawn is still on screen
+    if (!cameraUpdated && !sceneChanged && eventHandler.idle())
+        eventHandler.skipFrame();
+    else
+    {
+        redraw(eventHandler);
+        sceneChanged = false;
+    }
+
+    // Free this frame's transient allocations
+    FrameArena::frame().reset();
 }
 
 int main(int argc, char** argv)
 {
-    EventHandler eventHandler("Hello Image");
+    bool threadSweep = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            ThreadPool::setThreadCount(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--thread-sweep"))
+            threadSweep = true;
+    }
+
+    EventHandler eventHandler("Hello Image", argc, argv);
+    if (threadSweep)
+        sweepThreads();
+    TextureManager::shared().parseArgs(argc, argv);
+    eventHandler.addReportSection(GLResource::writeReport);
+    eventHandler.addReportSection([](char* buffer, size_t size) { return TextureManager::shared().writeReport(buffer, size); });
 
     // Initialize graphics
     initShaders(eventHandler);
-    initGeometry();
-    initTexture(eventHandler);
+    initGeometry(eventHandler);
+    textureHandle = TextureManager::shared().add("background", textureObj, [&]() { initTexture(eventHandler); });
+    TextureManager::shared().reload(textureHandle);
+    GLResource::printReport("after init");
+    TextureManager::shared().printReport("after init");
 
     // Start the main loop
     void* mainLoopArg = &eventHandler;
@@ -370,6 +450,7 @@ int main(int argc, char** argv)
         mainLoop(mainLoopArg);
 #endif
 
+    TextureManager::shared().remove(textureHandle);
     freeTexture();
     return 0;
 }
\ No newline at end of file
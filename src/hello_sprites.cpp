@@ -0,0 +1,416 @@
+//
+// Emscripten/SDL2/OpenGLES2 sample that draws many world space sprites with a sprite batch, culled with a spatial index
+//
+// Setup:
+//     Install emscripten: http://kripken.github.io/emscripten-site/docs/getting_started/downloads.html
+//
+// Build:
+//     emcc -std=c++11 hello_sprites.cpp events.cpp camera.cpp spatial.cpp spritebatch.cpp streambuffer.cpp atlas.cpp glresource.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=0 -s ALLOW_MEMORY_GROWTH=1 -o hello_sprites.html
+//
+// Run:
+//     emrun hello_sprites.html
+//
+// Options:
+//     --sprites <count>    Number of sprites (default 100000)
+//     --per-object         Draw each sprite with its own draw call instead of the sprite batch, for comparison
+//     --no-atlas           Give each sprite image its own texture instead of packing them into an atlas, for comparison
+//     --spatial-benchmark <items>  Time building the spatial grid, rect (culling) queries and point (picking) queries
+//                                  at 1e5 items and each power of 10 up to this many, e.g. 10000000, against linear scans
+//
+// Result:
+//     A field of colored sprites.  Left mouse pans, mouse wheel zooms in/out.  Window is resizable.
+//
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+#include <algorithm>
+#include <math.h>
+#include <SDL.h>
+#include <SDL_opengles2.h>
+
+#include "events.h"
+#include "spatial.h"
+#include "spritebatch.h"
+#include "atlas.h"
+#include "glresource.h"
+
+// #define SPRITES_DEBUG
+
+// Scene
+const float cWorldSize = 10.0f;
+int spriteCount = 100000;
+bool perObject = false;
+bool useAtlas = true;
+std::vector<Sprite> sprites;
+SpatialGrid* spatialGrid = nullptr;
+std::vector<unsigned int> visibleSprites;
+bool sceneChanged = true; // Since the last frame drawn, other than by the camera
+
+// Sprite batch and textures
+SpriteBatch spriteBatch;
+GLuint spriteProgram = 0;
+GLuint textures[2] = {0, 0};          // Atlas page, or the separate textures
+GLTexture separateTextures[2];
+TextureAtlas* atlas = nullptr;
+TextureAtlas::Region spriteRegions[2];
+
+const GLchar* spriteFragmentSource =
+    "precision mediump float;                                   \n"
+    "uniform sampler2D texSampler;                              \n"
+    "varying vec2 vTexCoord;                                    \n"
+    "varying vec4 vColor;                                       \n"
+    "void main()                                                \n"
+    "{                                                          \n"
+    "    gl_FragColor = texture2D(texSampler, vTexCoord) * vColor; \n"
+    "}                                                          \n";
+
+// Per object drawing, for comparison: one unit quad VBO, sprite rect (relative to the eye), uv rect and color as uniforms
+GLBuffer quadVbo;
+GLProgram perObjectProgram;
+GLint shaderZoom, shaderAspect, shaderRect, shaderUvRect, shaderColor;
+const GLchar* perObjectVertexSource =
+    "uniform float zoom;                                        \n"
+    "uniform float aspect;                                      \n"
+    "uniform vec4 rect;                                         \n"
+    "uniform vec4 uvRect;                                       \n"
+    "uniform vec4 color;                                        \n"
+    "attribute vec2 corner;                                     \n"
+    "varying vec2 vTexCoord;                                    \n"
+    "varying vec4 vColor;                                       \n"
+    "void main()                                                \n"
+    "{                                                          \n"
+    "    vec2 position = rect.xy + corner * rect.zw;            \n"
+    "    gl_Position = vec4(position * zoom, 0.0, 1.0);         \n"
+    "    gl_Position.y *= aspect;                               \n"
+    "    vTexCoord = mix(uvRect.xy, uvRect.zw, corner);         \n"
+    "    vColor = color;                                        \n"
+    "}                                                          \n";
+
+void updateShader(EventHandler& eventHandler)
+{
+    Camera& camera = eventHandler.camera();
+
+    glUseProgram(perObjectProgram);
+    glUniform1f(shaderZoom, camera.zoom()); 
+    glUniform1f(shaderAspect, camera.aspect());
+}
+
+GLProgram initShader(const GLchar* vertexSource, const GLchar* fragmentSource)
+{
+    // Create and compile vertex shader
+    GLShader vertexShader = GLShader::compile(GL_VERTEX_SHADER, vertexSource);
+
+    // Create and compile fragment shader
+    GLShader fragmentShader = GLShader::compile(GL_FRAGMENT_SHADER, fragmentSource);
+
+    // Link vertex and fragment shader into shader program.  The shaders are deleted on return, once linked.
+    GLProgram shaderProgram = GLProgram::create();
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    glBindAttribLocation(shaderProgram, 0, "corner");
+    glLinkProgram(shaderProgram);
+
+    return shaderProgram;
+}
+
+void initShaders(EventHandler& eventHandler)
+{
+    spriteBatch.init();
+    spriteProgram = spriteBatch.buildProgram(spriteFragmentSource);
+
+    perObjectProgram = initShader(perObjectVertexSource, spriteFragmentSource);
+    shaderZoom = glGetUniformLocation(perObjectProgram, "zoom");    
+    shaderAspect = glGetUniformLocation(perObjectProgram, "aspect");
+    shaderRect = glGetUniformLocation(perObjectProgram, "rect");
+    shaderUvRect = glGetUniformLocation(perObjectProgram, "uvRect");
+    shaderColor = glGetUniformLocation(perObjectProgram, "color");
+
+    updateShader(eventHandler);
+}
+
+void initGeometry()
+{
+    // Unit quad for per object drawing, as a triangle strip
+    quadVbo = GLBuffer::create();
+    GLfloat quadVertices[] = 
+    {
+        0.0f, 0.0f,
+        1.0f, 0.0f,
+        0.0f, 1.0f,
+        1.0f, 1.0f
+    };
+    quadVbo.data(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+}
+
+void initTextures()
+{
+    // A white disc and a white ring, tinted by sprite color
+    const int size = 32;
+    std::vector<GLubyte> pixels(size * size * 4);
+    if (useAtlas)
+        atlas = new TextureAtlas(256);
+    for (int t = 0; t < 2; ++t)
+    {
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+            {
+                float dx = x + 0.5f - size / 2.0f, dy = y + 0.5f - size / 2.0f, 
+                      r = sqrtf(dx * dx + dy * dy) / (size / 2.0f);
+                bool inside = (t == 0) ? r < 1.0f : (r < 1.0f && r > 0.6f);
+                GLubyte* pixel = &pixels[(y * size + x) * 4];
+                pixel[0] = pixel[1] = pixel[2] = 255;
+                pixel[3] = inside ? 255 : 0;
+            }
+
+        if (useAtlas)
+        {
+            spriteRegions[t] = atlas->region(atlas->add(pixels.data(), size, size, size * 4));
+            continue;
+        }
+
+        separateTextures[t] = GLTexture::create();
+        textures[t] = separateTextures[t];
+        glBindTexture(GL_TEXTURE_2D, textures[t]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        separateTextures[t].image2D(0, GL_RGBA, size, size, GL_UNSIGNED_BYTE, pixels.data());
+        spriteRegions[t] = {0, 0, 0, size, size, 0.0f, 0.0f, 1.0f, 1.0f};
+    }
+
+    // Both images share one atlas page, so the batch draws them without texture switches
+    if (useAtlas)
+    {
+        atlas->build();
+        textures[0] = textures[1] = atlas->pageTexture(spriteRegions[0].page);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Enable blending for texture alpha component
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void initScene()
+{
+    // Random sprites over the world, indexed by a spatial grid for culling
+    const WorldRect extent = {-cWorldSize, -cWorldSize, cWorldSize, cWorldSize};
+    spatialGrid = new SpatialGrid(extent, spriteCount);
+    sprites.resize(spriteCount);
+
+    srand(1);
+    auto random = []() { return rand() / (float)RAND_MAX; };
+    for (int i = 0; i < spriteCount; ++i)
+    {
+        Sprite& sprite = sprites[i];
+        sprite.width = sprite.height = 0.01f + random() * 0.04f;
+        sprite.x = (random() * 2.0f - 1.0f) * cWorldSize;
+        sprite.y = (random() * 2.0f - 1.0f) * cWorldSize;
+        const TextureAtlas::Region& region = spriteRegions[i % 2];
+        sprite.u0 = region.u0;
+        sprite.v0 = region.v0;
+        sprite.u1 = region.u1;
+        sprite.v1 = region.v1;
+        sprite.color[0] = (GLubyte)(64 + random() * 191);
+        sprite.color[1] = (GLubyte)(64 + random() * 191);
+        sprite.color[2] = (GLubyte)(64 + random() * 191);
+        sprite.color[3] = 255;
+        sprite.texture = textures[i % 2];
+        sprite.program = spriteProgram;
+
+        spatialGrid->insert(i, {sprite.x, sprite.y, sprite.x + sprite.width, sprite.y + sprite.height});
+    }
+    printf("INFO: %d sprites, %dx%d grid cells\n", spriteCount, spatialGrid->cellsPerAxis(), spatialGrid->cellsPerAxis());
+}
+
+void updateVisibleSprites(EventHandler& eventHandler)
+{
+    visibleSprites.clear();
+    spatialGrid->queryRect(eventHandler.camera().visibleWorldRect(), visibleSprites);
+}
+
+void redraw(EventHandler& eventHandler)
+{
+    // Clear screen
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (perObject)
+    {
+        // One draw call per sprite
+        glUseProgram(perObjectProgram);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVbo);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+        const Vec2d& pan = eventHandler.camera().worldPan();
+        for (unsigned int id : visibleSprites)
+        {
+            const Sprite& s = sprites[id];
+            glBindTexture(GL_TEXTURE_2D, s.texture);
+            glUniform4f(shaderRect, (GLfloat)(s.x + pan.x), (GLfloat)(s.y + pan.y), s.width, s.height);
+            glUniform4f(shaderUvRect, s.u0, s.v0, s.u1, s.v1);
+            glUniform4f(shaderColor, s.color[0] / 255.0f, s.color[1] / 255.0f, s.color[2] / 255.0f, s.color[3] / 255.0f);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+        glDisableVertexAttribArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    else
+    {
+        // Batched by texture
+        spriteBatch.begin(eventHandler.camera());
+        for (unsigned int id : visibleSprites)
+            spriteBatch.draw(sprites[id]);
+        spriteBatch.end();
+
+        #ifdef SPRITES_DEBUG
+            SpriteBatch::Stats& stats = spriteBatch.stats();
+            StreamBuffer::Stats& streamStats = spriteBatch.streamStats();
+            printf ("sprites=%u drawCalls=%u stateChanges=%u streamed=%u bytes orphans=%u (previous frame)\n", 
+                    stats.sprites, stats.drawCalls, stats.stateChanges, (unsigned int)streamStats.bytes, streamStats.orphans);
+        #endif
+    }
+
+    // Swap front/back framebuffers and publish this frame's culling counts
+    eventHandler.swapWindow();
+    eventHandler.camera().endCullFrame();
+}
+
+void mainLoop(void* mainLoopArg) 
+{   
+    EventHandler& eventHandler = *((EventHandler*)mainLoopArg);
+    eventHandler.processEvents();
+
+    // Update shader and visible sprites if camera changed
+    bool cameraUpdated = eventHandler.camera().updated();
+    if (cameraUpdated)
+    {
+        updateShader(eventHandler);
+        updateVisibleSprites(eventHandler);
+    }
+
+    // Nothing moved, so the last frame drawn is still on screen
+    if (!cameraUpdated && !sceneChanged && eventHandler.idle())
+        eventHandler.skipFrame();
+    else
+    {
+        redraw(eventHandler);
+        sceneChanged = false;
+    }
+}
+
+// Time grid builds and queries at 1e5 items and each power of 10 up to maxItems. The world grows with the item count,
+// keeping the sample's item density, and queries cover a window sized area, as culling and picking would.
+void benchmarkSpatialGrid(int maxItems)
+{
+    auto ms = [](Uint64 startCounter) { return (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency(); };
+    auto random = []() { return rand() / (double)RAND_MAX; };
+    for (int count = 100000; count <= maxItems; count *= 10)
+    {
+        double worldSize = cWorldSize * sqrt(count / 100000.0);
+        std::vector<WorldRect> bounds(count);
+        srand(1);
+        for (WorldRect& b : bounds)
+        {
+            double size = 0.01 + random() * 0.04;
+            b.minX = (random() * 2.0 - 1.0) * worldSize;
+            b.minY = (random() * 2.0 - 1.0) * worldSize;
+            b.maxX = b.minX + size;
+            b.maxY = b.minY + size;
+        }
+
+        Uint64 startCounter = SDL_GetPerformanceCounter();
+        SpatialGrid grid({-worldSize, -worldSize, worldSize + 0.05, worldSize + 0.05}, count);
+        for (int i = 0; i < count; ++i)
+            grid.insert(i, bounds[i]);
+        double buildMs = ms(startCounter);
+
+        // Window sized rects, as at zoom 1
+        const int rectQueries = 1000;
+        std::vector<WorldRect> rects(rectQueries);
+        for (WorldRect& rect : rects)
+        {
+            rect.minX = (random() * 2.0 - 1.0) * worldSize;
+            rect.minY = (random() * 2.0 - 1.0) * worldSize;
+            rect.maxX = rect.minX + 2.0;
+            rect.maxY = rect.minY + 2.0;
+        }
+        std::vector<unsigned int> results;
+        size_t rectResults = 0;
+        startCounter = SDL_GetPerformanceCounter();
+        for (const WorldRect& rect : rects)
+        {
+            results.clear();
+            grid.queryRect(rect, results);
+            rectResults += results.size();
+        }
+        double rectMs = ms(startCounter) / rectQueries;
+
+        const int pointQueries = 100000;
+        size_t pointResults = 0;
+        startCounter = SDL_GetPerformanceCounter();
+        for (int i = 0; i < pointQueries; ++i)
+        {
+            results.clear();
+            grid.queryPoint((random() * 2.0 - 1.0) * worldSize, (random() * 2.0 - 1.0) * worldSize, results);
+            pointResults += results.size();
+        }
+        double pointUs = ms(startCounter) * 1000.0 / pointQueries;
+
+        // What the grid saves: one linear scan over every item for a rect
+        size_t scanResults = 0;
+        startCounter = SDL_GetPerformanceCounter();
+        for (const WorldRect& b : bounds)
+            scanResults += b.maxX >= rects[0].minX && b.minX <= rects[0].maxX && b.maxY >= rects[0].minY && b.minY <= rects[0].maxY;
+        double scanMs = ms(startCounter);
+
+        printf("INFO: Spatial grid, %d items, %dx%d cells: build %.1f ms, rect query %.3f ms (%.0f hits, linear scan %.2f ms, "
+               "%zu hits), point query %.2f us (%.2f hits)\n", count, grid.cellsPerAxis(), grid.cellsPerAxis(), buildMs, rectMs,
+               (double)rectResults / rectQueries, scanMs, scanResults, pointUs, (double)pointResults / pointQueries);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int benchmarkItems = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--sprites") && i + 1 < argc)
+            spriteCount = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--per-object"))
+            perObject = true;
+        else if (!strcmp(argv[i], "--no-atlas"))
+            useAtlas = false;
+        else if (!strcmp(argv[i], "--spatial-benchmark") && i + 1 < argc)
+            benchmarkItems = atoi(argv[++i]);
+    }
+
+    EventHandler eventHandler("Hello Sprites", argc, argv);
+    eventHandler.addReportSection(GLResource::writeReport);
+
+    // Initialize graphics and scene
+    initShaders(eventHandler);
+    initGeometry();
+    initTextures();
+    initScene();
+    GLResource::printReport("after init");
+    updateVisibleSprites(eventHandler);
+    if (benchmarkItems > 0)
+        benchmarkSpatialGrid(benchmarkItems);
+
+    // Start the main loop
+    void* mainLoopArg = &eventHandler;
+
+#ifdef __EMSCRIPTEN__
+    int fps = 0; // Use browser's requestAnimationFrame
+    emscripten_set_main_loop_arg(mainLoop, mainLoopArg, fps, true);
+#else
+    while(true) 
+        mainLoop(mainLoopArg);
+#endif
+
+    delete spatialGrid;
+    return 0;
+}
@@ -5,11 +5,18 @@
 //     Install emscripten: http://kripken.github.io/emscripten-site/docs/getting_started/downloads.html
 //
 // Build:
-//     emcc -std=c++11 hello_text_ttf.cpp events.cpp camera.cpp -s USE_SDL=2 -s USE_SDL_TTF=2 -s FULL_ES2=1 -s WASM=0 --preload-file media/LiberationSansBold.ttf -o hello_text_ttf.html
+//     emcc -std=c++11 hello_text_ttf.cpp events.cpp camera.cpp assets.cpp threadpool.cpp glresource.cpp texturemanager.cpp sdf.cpp mipmap.cpp -s USE_SDL=2 -s USE_SDL_TTF=2 -s FULL_ES2=1 -s WASM=0 -o hello_text_ttf.html
 // 
 // Run:
 //     emrun hello_text_ttf.html
 //
+//     The font is fetched on demand from media/ next to the page, so serve the page from this directory.
+//
+// Options:
+//     --sdf    Draw the text from a signed distance field, built from a high resolution rendering, and scale it
+//              with the camera zoom.  Prints the field's build time and memory against bitmap atlases per size.
+//     --no-mipmaps Sample the text texture without mipmaps, for comparison when zoomed out with --sdf
+//
 // Result:
 //     A TTF text quad and colorful triangle.  Left mouse pans, mouse wheel zooms in/out.
 //
@@ -18,42 +25,71 @@
 #include <emscripten.h>
 #endif
 
+#include <math.h>
+#include <vector>
 #include <SDL.h>
 #include <SDL_ttf.h>
 #include <SDL_opengles2.h>
 
 #include "events.h"
+#include "assets.h"
+#include "glresource.h"
+#include "texturemanager.h"
+#include "sdf.h"
+#include "mipmap.h"
 
 // Geometry
-GLuint triangleVbo = 0;
-GLuint quadVbo = 0;
+GLBuffer triangleVbo;
+const double triangleWorld[] = { 0.0, 0.5,  -0.5, -0.5,  0.5, -0.5 }; // Uploaded relative to the eye by updateGeometry()
+const WorldRect triangleBounds = {-0.5, -0.5, 0.5, 0.5};
+bool sceneChanged = true; // Since the last frame drawn, other than by the camera
+GLBuffer quadVbo;
 
-// Texture
-GLuint textureObj = 0;
+// Texture, re-rendered by the texture manager if evicted
+GLTexture textureObj;
+int textureHandle = -1;
 
 // Text
 const char* cFontName = "media/LiberationSansBold.ttf";
 const int cFontPointSize = 64;
 const char* message = "Hello Text";
+std::vector<unsigned char> fontFile; // Kept to re-render the text if its texture is evicted
+AssetManifest manifest({ cFontName });
+AssetLoader* fontLoader = nullptr; // Rendering the text on a worker, until uploaded
+
+// Text coverage (or distance field), 8 bits per texel, in the bottom left of a power of 2 upload buffer
+std::vector<unsigned char> textPixels;
+int textureWidth = 0, textureHeight = 0;
+int textWidth = 0, textHeight = 0; // Text's size in the texture, including its border
+double textRenderMs = 0.0;
+bool useMipmaps = true;
+std::vector<MipLevel> textMipLevels;
+
+// Signed distance field text: rendered at cSdfScale times the field's point size, then downsampled
+bool useSdf = false;
+const int cSdfPointSize = 32;
+const int cSdfScale = 8;
+const float cSdfSpread = 4.0f; // Field texels from the edge to 0 or 255
 
 // Shader vars
 const GLint positionAttrib = 0;
-GLint shaderPan, shaderZoom, shaderAspect, shaderViewport, shaderTextSize, shaderTexSize;
+GLint shaderZoom, shaderAspect, shaderViewport, shaderTextSize, shaderTexSize, shaderTextScale, shaderSmoothing;
 GLfloat textSize[2] = {0.0f, 0.0f}, texSize[2] = {0.0f, 0.0f};
 
 // Text quad vertex & fragment shaders
-GLuint quadShaderProgram = 0;
+GLProgram quadShaderProgram;
 const GLchar* quadVertexSource =
     "attribute vec4 position;                                   \n"
     "varying vec2 texCoord;                                     \n"
     "uniform vec2 viewport;                                     \n"
     "uniform vec2 textSize;                                     \n"
     "uniform vec2 texSize;                                      \n"
+    "uniform float textScale;                                   \n"
     "void main()                                                \n"
     "{                                                          \n"
     "    gl_Position = vec4(position.xyz, 1.0);                 \n"
-    "    gl_Position.x *= textSize.x;                           \n"
-    "    gl_Position.y *= textSize.y;                           \n"
+    "    gl_Position.x *= textSize.x * textScale;               \n"
+    "    gl_Position.y *= textSize.y * textScale;               \n"
     "                                                           \n"
     "    // Translate to lower left viewport                    \n"
     "    gl_Position.x -= viewport.x / 2.0;                     \n"
@@ -70,19 +106,33 @@ const GLchar* quadVertexSource =
     "    texCoord.y = -position.y * textSize.y / texSize.y;     \n"
     "}                                                          \n";
 
+// Coverage colors the text white, on a gray, half transparent background
 const GLchar* quadFragmentSource =
     "precision mediump float;                                   \n"
     "varying vec2 texCoord;                                     \n"
     "uniform sampler2D texSampler;                              \n"
     "void main()                                                \n"
     "{                                                          \n"
-    "    gl_FragColor = texture2D(texSampler, texCoord);        \n"
+    "    float a = texture2D(texSampler, texCoord).a;           \n"
+    "    gl_FragColor = mix(vec4(0.5), vec4(1.0), a);           \n"
+    "}                                                          \n";
+
+// Distance field text: threshold at the edge, antialiased over about a pixel, on the bitmap text's gray background
+const GLchar* sdfFragmentSource =
+    "precision mediump float;                                   \n"
+    "varying vec2 texCoord;                                     \n"
+    "uniform sampler2D texSampler;                              \n"
+    "uniform float smoothing;                                   \n"
+    "void main()                                                \n"
+    "{                                                          \n"
+    "    float distance = texture2D(texSampler, texCoord).a;    \n"
+    "    float a = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance); \n"
+    "    gl_FragColor = mix(vec4(0.5), vec4(1.0), a);           \n"
     "}                                                          \n";
 
 // Colorful triangle vertex & fragment shaders
-GLuint triShaderProgram = 0;
+GLProgram triShaderProgram;
 const GLchar* triVertexSource =
-    "uniform vec2 pan;                             \n"
     "uniform float zoom;                           \n"
     "uniform float aspect;                         \n"
     "attribute vec4 position;                      \n"
@@ -90,7 +140,6 @@ const GLchar* triVertexSource =
     "void main()                                   \n"
     "{                                             \n"
     "    gl_Position = vec4(position.xyz, 1.0);    \n"
-    "    gl_Position.xy += pan;                    \n"
     "    gl_Position.xy *= zoom;                   \n"
     "    gl_Position.y *= aspect;                  \n"
     "    color = gl_Position.xyz + vec3(0.5);      \n"
@@ -121,26 +170,27 @@ void updateShader(EventHandler& eventHandler)
     glUniform2fv(shaderTextSize, 1, textSize);
     glUniform2fv(shaderTexSize, 1, texSize);
 
+    // The field is drawn at the bitmap text's size, scaled with the zoom. Its values change by 0.5 / cSdfSpread
+    // per field texel, so smoothing over half a pixel either side of the edge is 0.25 / cSdfSpread per pixel.
+    GLfloat textScale = useSdf ? (GLfloat)(camera.zoom() * cFontPointSize / cSdfPointSize) : 1.0f;
+    glUniform1f(shaderTextScale, textScale);
+    glUniform1f(shaderSmoothing, 0.25f / (cSdfSpread * textScale));
+
     glUseProgram(triShaderProgram);
-    glUniform2fv(shaderPan, 1, camera.pan());
     glUniform1f(shaderZoom, camera.zoom()); 
     glUniform1f(shaderAspect, camera.aspect());
 }
 
-GLuint initShader(const GLchar* vertexSource, const GLchar* fragmentSource)
+GLProgram initShader(const GLchar* vertexSource, const GLchar* fragmentSource)
 {
     // Create and compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
-    glCompileShader(vertexShader);
+    GLShader vertexShader = GLShader::compile(GL_VERTEX_SHADER, vertexSource);
 
     // Create and compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-    glCompileShader(fragmentShader);
+    GLShader fragmentShader = GLShader::compile(GL_FRAGMENT_SHADER, fragmentSource);
 
-    // Link vertex and fragment shader into shader program
-    GLuint shaderProgram = glCreateProgram();
+    // Link vertex and fragment shader into shader program.  The shaders are deleted on return, once linked.
+    GLProgram shaderProgram = GLProgram::create();
     glAttachShader(shaderProgram, vertexShader);
     glAttachShader(shaderProgram, fragmentShader);
     glBindAttribLocation(shaderProgram, positionAttrib, "position");
@@ -153,26 +203,35 @@ GLuint initShader(const GLchar* vertexSource, const GLchar* fragmentSource)
 void initShaders(EventHandler& eventHandler)
 {
     // Compile & link shaders
-    quadShaderProgram = initShader(quadVertexSource, quadFragmentSource);
+    quadShaderProgram = initShader(quadVertexSource, useSdf ? sdfFragmentSource : quadFragmentSource);
     triShaderProgram = initShader(triVertexSource, triFragmentSource);
 
     // Get shader variables and initalize them
     shaderViewport = glGetUniformLocation(quadShaderProgram, "viewport");
     shaderTextSize = glGetUniformLocation(quadShaderProgram, "textSize");
     shaderTexSize = glGetUniformLocation(quadShaderProgram, "texSize");
+    shaderTextScale = glGetUniformLocation(quadShaderProgram, "textScale");
+    shaderSmoothing = glGetUniformLocation(quadShaderProgram, "smoothing");
 
-    shaderPan = glGetUniformLocation(triShaderProgram, "pan");
     shaderZoom = glGetUniformLocation(triShaderProgram, "zoom");    
     shaderAspect = glGetUniformLocation(triShaderProgram, "aspect");
     
     updateShader(eventHandler);
 }
 
-void initGeometry()
+void updateGeometry(EventHandler& eventHandler)
+{
+    // Rebase the triangle's world coords relative to the eye and copy them into its vertex buffer
+    GLfloat vertices[sizeof(triangleWorld) / sizeof(double)];
+    eventHandler.camera().worldToEyeRelative(triangleWorld, vertices, 3);
+    glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+}
+
+void initGeometry(EventHandler& eventHandler)
 {
    // Create vertex buffer objects and copy vertex data into them
-    glGenBuffers(1, &quadVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVbo);
+    quadVbo = GLBuffer::create();
     GLfloat quadVertices[] = 
     {
         0.0f, 1.0f, 0.0f,
@@ -180,114 +239,156 @@ void initGeometry()
         0.0f, 0.0f, 0.0f,
         1.0f, 0.0f, 0.0f
     };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    quadVbo.data(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
 
-    glGenBuffers(1, &triangleVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
-    GLfloat triangleVertices[] = 
-    {
-        0.0f, 0.5f, 0.0f,
-        -0.5f, -0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f
-    };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(triangleVertices), triangleVertices, GL_STATIC_DRAW);  
+    triangleVbo = GLBuffer::create();
+    triangleVbo.data(GL_ARRAY_BUFFER, sizeof(triangleWorld) / sizeof(double) * sizeof(GLfloat), nullptr, GL_DYNAMIC_DRAW);
+    updateGeometry(eventHandler);
  }
 
-void debugPrintSurface(SDL_Surface* surface, const char* name, bool dumpPixels)
+void readFontFile()
+{
+    readFile(cFontName, fontFile);
+}
+
+// Size and clear the upload buffer for text of width x height texels, returning where the text's top row goes
+unsigned char* allocateTextPixels(int width, int height)
+{
+    textWidth = width;
+    textHeight = height;
+    textureWidth = nextPowerOfTwo(width);
+    textureHeight = nextPowerOfTwo(height);
+    textPixels.assign((size_t)textureWidth * textureHeight, 0);
+    return &textPixels[(size_t)(textureHeight - height) * textureWidth];
+}
+
+// Render the text at high resolution and build its distance field into an 8 bit texture, laid out like the
+// bitmap text's in the bottom left, with the field's falloff as its border
+void renderTextDistanceField(TTF_Font* font)
 {
-    printf ("%s dimensions %dx%d, %d bits per pixel\n", name, surface->w, surface->h, surface->format->BitsPerPixel);
-    if (dumpPixels)
+    Uint64 startCounter = SDL_GetPerformanceCounter();
+    SDL_Color foregroundColor = {255,255,255,255};
+    SDL_Surface* bitmap = TTF_RenderText_Solid(font, message, foregroundColor);
+    if (!bitmap)
+        return;
+    Uint64 renderedCounter = SDL_GetPerformanceCounter();
+
+    // Pad the bitmap so the field falls off before its border, to a multiple of the downsampling scale
+    int pad = (int)ceilf(cSdfSpread) * cSdfScale;
+    int width = (bitmap->w + 2 * pad + cSdfScale - 1) / cSdfScale * cSdfScale;
+    int height = (bitmap->h + 2 * pad + cSdfScale - 1) / cSdfScale * cSdfScale;
+    std::vector<unsigned char> padded((size_t)width * height, 0);
+    for (int y = 0; y < bitmap->h; ++y)
+        memcpy(&padded[(size_t)(y + pad) * width + pad], (unsigned char*)bitmap->pixels + y * bitmap->pitch, bitmap->w);
+    int bitmapWidth = bitmap->w, bitmapHeight = bitmap->h;
+    SDL_FreeSurface(bitmap);
+
+    buildDistanceField(padded.data(), width, height, width, cSdfScale, cSdfSpread,
+                       allocateTextPixels(width / cSdfScale, height / cSdfScale), textureWidth);
+
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    double renderMs = (renderedCounter - startCounter) * 1000.0 / frequency;
+    double fieldMs = (SDL_GetPerformanceCounter() - renderedCounter) * 1000.0 / frequency;
+    textRenderMs = renderMs + fieldMs;
+
+    // Compare with RGBA bitmap text for zooms of 1x to 8x, each in a power of 2 texture with a 1 texel border
+    size_t bitmapBytes = 0;
+    for (int size = 1; size <= 8; size *= 2)
     {
-        for (int i = 0; i < surface->w * surface->h; ++i)
-            printf("%x ", ((unsigned int*)surface->pixels)[i]);
-        printf("\n");
+        int bitmapScale = cSdfPointSize * cSdfScale;
+        bitmapBytes += (size_t)nextPowerOfTwo(bitmapWidth * cFontPointSize * size / bitmapScale + 2) *
+                       nextPowerOfTwo(bitmapHeight * cFontPointSize * size / bitmapScale + 2) * 4;
     }
+    printf("INFO: Distance field text %dx%d in a %dx%d texture, %.1f KB, rendered in %.2f ms and built in %.2f ms, "
+           "vs %.1f KB of bitmap text at 1x, 2x, 4x and 8x\n", textWidth, textHeight, textureWidth, textureHeight,
+           textPixels.size() / 1024.0, renderMs, fieldMs, bitmapBytes / 1024.0);
 }
 
-void initTextTexture(EventHandler& eventHandler)
+void renderTextImage()
 {
-    TTF_Init();
-
-    // Load the font
-    TTF_Font *font = TTF_OpenFont(cFontName, cFontPointSize);
-    if (font) 
+    // Load the font, at the high resolution size for a distance field
+    int pointSize = useSdf ? cSdfPointSize * cSdfScale : cFontPointSize;
+    TTF_Font *font = TTF_OpenFontRW(SDL_RWFromConstMem(fontFile.data(), (int)fontFile.size()), 1, pointSize);
+    if (font && useSdf)
     {
-        // Render text to surface
-        SDL_Color foregroundColor = {255,255,255,255};
-        SDL_Surface* textImage8Bit = TTF_RenderText_Solid(font, message, foregroundColor);
-        
-        if (textImage8Bit)
+        renderTextDistanceField(font);
+        TTF_CloseFont(font);
+    }
+    else if (font) 
+    {
+        // Render antialiased coverage, 8 bits per texel, straight into the upload buffer with a 1 texel border
+        Uint64 startCounter = SDL_GetPerformanceCounter();
+        SDL_Color foregroundColor = {255,255,255,255}, backgroundColor = {0,0,0,0};
+        SDL_Surface* coverage = TTF_RenderText_Shaded(font, message, foregroundColor, backgroundColor);
+        if (coverage)
         {
-            // Convert surface from 8 to 32 bit for GL
-            SDL_Surface* textImage = SDL_ConvertSurfaceFormat(textImage8Bit, SDL_PIXELFORMAT_RGBA8888, 0);
-            debugPrintSurface(textImage, "textImage", false);
-
-            // Create power of 2 dimensioned texture for GL with 1 texel border, clear it, and copy text image into it
-            SDL_Surface* texture = SDL_CreateRGBSurface(0, nextPowerOfTwo(textImage->w + 2), nextPowerOfTwo(textImage->h + 2), 
-                                                        textImage->format->BitsPerPixel, 0, 0, 0, 0);
-            memset(texture->pixels, 0x0, texture->w * texture->h * texture->format->BytesPerPixel);
-            SDL_Rect destRect = {1, texture->h - textImage->h - 1, textImage->w + 1, texture->h - 1};
-            SDL_SetSurfaceBlendMode(textImage, SDL_BLENDMODE_NONE);
-            SDL_BlitSurface(textImage, NULL, texture, &destRect);
- 
-            // Emscripten/SDL bug? SDL_BlitSurface should copy source alpha when source surface is set to 
-            // SDL_BLENDMODE_NONE, however this is not happening, so fix it up here
-            unsigned int* pixels = (unsigned int*)texture->pixels;
-            for (int i = 0; i < texture->w*texture->h; ++i)
-            {
-                if (pixels[i] != 0)
-                    pixels[i] |= 0xff000000;
-                else
-                    pixels[i] = 0x80808080;
-            }
-            debugPrintSurface(texture, "texture", false);
-
-            // Determine GL texture format
-            GLint format = -1;
-            if (texture->format->BitsPerPixel == 24)
-                format = GL_RGB;
-            else if (texture->format->BitsPerPixel == 32)
-                format = GL_RGBA;
-
-            if (format != -1)
-            {
-                // Enable blending for texture alpha component
-                glEnable( GL_BLEND );
-                glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-
-                // Generate a GL texture object
-                glGenTextures(1, &textureObj);
-
-                // Bind GL texture
-                glBindTexture(GL_TEXTURE_2D, textureObj);
-
-                // Set the GL texture's wrapping and stretching properties
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-                // Copy SDL surface image to GL texture
-                glTexImage2D(GL_TEXTURE_2D, 0, format, 
-                             texture->w, texture->h, 
-                             0, format, GL_UNSIGNED_BYTE, texture->pixels);
-
-                // Update quad shader
-                texSize[0] = (GLfloat)texture->w;
-                texSize[1] = (GLfloat)texture->h;
-                textSize[0] = (GLfloat)textImage->w + 2;
-                textSize[1] = (GLfloat)textImage->h + 2;
-                updateShader(eventHandler);
-            }
-                                    
-            SDL_FreeSurface (textImage);        
-            SDL_FreeSurface (texture);        
-        }  
+            unsigned char* text = allocateTextPixels(coverage->w + 2, coverage->h + 2);
+            for (int y = 0; y < coverage->h; ++y)
+                memcpy(text + (size_t)(y + 1) * textureWidth + 1, (unsigned char*)coverage->pixels + y * coverage->pitch, coverage->w);
+            SDL_FreeSurface(coverage);
+            textRenderMs = (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency();
+        }
         TTF_CloseFont(font);
     }
     else
         printf("Failed to load font %s, due to %s\n", cFontName, TTF_GetError());
+
+    // Mipmap the text from its own texels only, not the texture's unused area
+    if (!textPixels.empty() && useMipmaps)
+    {
+        MipStats stats;
+        std::vector<MipRect> rects = { {0, textureHeight - textHeight, textWidth, textHeight} };
+        textMipLevels = buildAtlasMipmaps(textPixels.data(), textureWidth, textureHeight, textureWidth, 1, rects, &stats);
+        printf("INFO: Text mipmaps, %d levels, %.1f KB built in %.2f ms\n", stats.levels, stats.bytes / 1024.0, stats.buildMs);
+    }
+}
+
+void initTextTexture(EventHandler& eventHandler)
+{
+    if (!textPixels.empty())
+    {
+        Uint64 startCounter = SDL_GetPerformanceCounter();
+
+        // Enable blending for texture alpha component
+        glEnable( GL_BLEND );
+        glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+        // Generate a GL texture object
+        textureObj = GLTexture::create();
+
+        // Bind GL texture
+        glBindTexture(GL_TEXTURE_2D, textureObj);
+
+        // Set the GL texture's wrapping and stretching properties
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        // Distance fields are interpolated, which is what keeps their edges smooth when magnified
+        GLint filter = useSdf ? GL_LINEAR : GL_NEAREST;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, textMipLevels.empty() ? filter : GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+
+        // Copy the text, and its mipmaps, to the GL texture as alpha.  Rows are tightly packed, and mip level
+        // rows are narrower than 4 bytes near 1x1.
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        textureObj.image2D(0, GL_ALPHA, textureWidth, textureHeight, GL_UNSIGNED_BYTE, textPixels.data());
+        for (size_t i = 0; i < textMipLevels.size(); ++i)
+            textureObj.image2D((GLint)i + 1, GL_ALPHA, textMipLevels[i].width, textMipLevels[i].height, GL_UNSIGNED_BYTE,
+                               textMipLevels[i].pixels.data());
+        double uploadMs = (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency();
+        printf("INFO: Text changed, rendered in %.2f ms and uploaded in %.2f ms, %.1f KB as alpha rather than %.1f KB as RGBA\n",
+               textRenderMs, uploadMs, textureObj.bytes() / 1024.0, textureObj.bytes() * 4 / 1024.0);
+
+        // Update quad shader
+        texSize[0] = (GLfloat)textureWidth;
+        texSize[1] = (GLfloat)textureHeight;
+        textSize[0] = (GLfloat)textWidth;
+        textSize[1] = (GLfloat)textHeight;
+        updateShader(eventHandler);
+
+        textPixels.clear();
+        textMipLevels.clear();
+    }
 }
 
 void redraw(EventHandler& eventHandler)
@@ -295,42 +396,98 @@ void redraw(EventHandler& eventHandler)
     // Clear screen
     glClear(GL_COLOR_BUFFER_BIT);
 
-    // Draw the triangle VBO with a colorful shader
-    glUseProgram(triShaderProgram);
-    glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
-    glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    // Draw the triangle VBO with a colorful shader, unless culled
+    if (eventHandler.camera().isVisible(triangleBounds))
+    {
+        glUseProgram(triShaderProgram);
+        glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
+        glVertexAttribPointer(positionAttrib, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
     
     // Draw the quad VBO with a text texture shader
+    glBindTexture(GL_TEXTURE_2D, TextureManager::shared().use(textureHandle));
     glUseProgram(quadShaderProgram);
     glBindBuffer(GL_ARRAY_BUFFER, quadVbo);
     glVertexAttribPointer(positionAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-    // Swap front/back framebuffers
+    // Swap front/back framebuffers, publish this frame's culling counts, then evict textures not drawn this frame if over budget
     eventHandler.swapWindow();
+    eventHandler.camera().endCullFrame();
+    TextureManager::shared().endFrame();
 }
 
 void mainLoop(void* mainLoopArg) 
 {    
     EventHandler& eventHandler = *((EventHandler*)mainLoopArg);
     eventHandler.processEvents();
+    manifest.update();
 
-    // Update shader if camera changed
-    if (eventHandler.camera().updated())
+    // Upload the text once it's rendered, and hand it to the texture manager
+    if (fontLoader && fontLoader->update())
+    {
+        fontLoader->printTimeline();
+        delete fontLoader;
+        fontLoader = nullptr;
+        textureHandle = TextureManager::shared().add(message, textureObj, [&]() { renderTextImage(); initTextTexture(eventHandler); });
+        sceneChanged = true;
+    }
+
+    // Update shader and geometry if camera changed
+    bool cameraUpdated = eventHandler.camera().updated();
+    if (cameraUpdated)
+    {
         updateShader(eventHandler);
+        updateGeometry(eventHandler);
+    }
 
-    redraw(eventHandler);
+    // Nothing moved and nothing is loading, so the last frame drawn is still on screen
+    if (!cameraUpdated && !sceneChanged && !fontLoader && eventHandler.idle())
+        eventHandler.skipFrame();
+    else
+    {
+        redraw(eventHandler);
+        sceneChanged = false;
+    }
 }
 
 int main(int argc, char** argv)
 {
-    EventHandler eventHandler("Hello TTF Text");
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--sdf"))
+            useSdf = true;
+        else if (!strcmp(argv[i], "--no-mipmaps"))
+            useMipmaps = false;
+    }
 
-    // Initialize graphics
-    initShaders(eventHandler);
-    initGeometry();
-    initTextTexture(eventHandler);
+    EventHandler eventHandler("Hello TTF Text", argc, argv);
+    TextureManager::shared().parseArgs(argc, argv);
+    eventHandler.addReportSection(GLResource::writeReport);
+    eventHandler.addReportSection([](char* buffer, size_t size) { return TextureManager::shared().writeReport(buffer, size); });
+
+    // Initialize graphics while the font is fetched. Once it's here, it's read and the text rendered on a worker.
+    TTF_Init();
+    manifest.request(cFontName, [&](bool fetched)
+    {
+        if (!fetched)
+        {
+            printf("ERROR: No %s, drawing without text\n", cFontName);
+            return;
+        }
+        fontLoader = new AssetLoader();
+        fontLoader->add(cFontName, readFontFile, renderTextImage, [&]() { initTextTexture(eventHandler); });
+        fontLoader->start();
+    });
+    AssetLoader assets;
+    assets.add("shaders", nullptr, nullptr, [&]() { initShaders(eventHandler); });
+    assets.add("geometry", nullptr, nullptr, [&]() { initGeometry(eventHandler); });
+    assets.run();
+    assets.printTimeline();
+    GLResource::printReport("after init");
+    TextureManager::shared().printReport("after init");
+    manifest.printReport("after init");
 
     // Start the main loop
     void* mainLoopArg = &eventHandler;
@@ -343,7 +500,5 @@ int main(int argc, char** argv)
         mainLoop(mainLoopArg);
 #endif
 
-    glDeleteTextures(1, &textureObj);
-
     return 0;
 }
\ No newline at end of file
@@ -5,31 +5,59 @@
 //     Install emscripten: http://kripken.github.io/emscripten-site/docs/getting_started/downloads.html
 //
 // Build:
-//     emcc -std=c++11 hello_text_txf.cpp events.cpp camera.cpp texfont.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=0 --preload-file media/rockfont.txf -o hello_text_txf.html
+//     emcc -std=c++11 hello_text_txf.cpp events.cpp camera.cpp texfont.cpp streambuffer.cpp assets.cpp threadpool.cpp arena.cpp glresource.cpp texturemanager.cpp mipmap.cpp atlas.cpp heapcount.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=0 -o hello_text_txf.html
+//
+// Build with the SSE2 glyph run kernel, as WebAssembly SIMD (Emscripten 2.0 or newer; the asm.js build above is scalar):
+//     emcc -std=c++11 -msimd128 -msse2 hello_text_txf.cpp events.cpp camera.cpp texfont.cpp streambuffer.cpp assets.cpp threadpool.cpp arena.cpp glresource.cpp texturemanager.cpp mipmap.cpp atlas.cpp heapcount.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=1 -o hello_text_txf_simd.html
+//
+// Build counting heap allocations, for --assert-no-heap in replays and tests:
+//     emcc -std=c++11 -DCOUNT_HEAP_ALLOCATIONS hello_text_txf.cpp events.cpp camera.cpp texfont.cpp streambuffer.cpp assets.cpp threadpool.cpp arena.cpp glresource.cpp texturemanager.cpp mipmap.cpp atlas.cpp heapcount.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=1 -o hello_text_txf_heapcount.html
 // 
 // Run:
 //     emrun hello_text_txf.html
 //
+//     The font is fetched on demand from media/ next to the page, so serve the page from this directory.
+//
+// Options:
+//     --glyph-benchmark <glyphs>   Time building glyph runs of this many glyphs, on one thread and on the thread pool,
+//                                  and laying them out as GPU glyph instances
+//                                  (SIMD natively and in the -msimd128 -msse2 build, scalar in the asm.js build)
+//     --no-mipmaps                 Sample the font texture without mipmaps, for comparison when zoomed out
+//     --atlas-report               Repack the font's glyphs with the skyline texture atlas packer, printing its
+//                                  efficiency and pack time against the font's own layout
+//     --assert-no-heap             Assert that text frames after the first allocate nothing from the heap, counting operator new
+//                                  (in the -DCOUNT_HEAP_ALLOCATIONS build) and frame arena overflows, e.g. over a --replay
+//
 // Result:
-//     A TXF font quad and colorful triangle.  Left mouse pans, mouse wheel zooms in/out.
+//     A TXF font quad and colorful triangle, with text typed out in the lower left.  Left mouse pans, mouse wheel zooms in/out.
 //
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
+#include <algorithm>
+#include <vector>
 #include <SDL.h>
 #include <SDL_opengles2.h>
 
 #include "events.h"
+#include "assets.h"
 #include "texfont.h"
-
-// Vertex attribute indices for all shaders
+#include "threadpool.h"
+#include "arena.h"
+#include "glresource.h"
+#include "texturemanager.h"
+#include "atlas.h"
+#include "heapcount.h"
+
+// Vertex attribute indices for all shaders (GPU laid out text uses corner, pen and glyph at 0, 1 and 2)
 const GLuint vertexPositionIndex = 0, 
-             vertexTexCoordIndex = 1;
+             vertexTexCoordIndex = 1,
+             vertexOffsetIndex = 2;
 
 // Text quads geometry and vertex shader
-GLuint quadsTextShaderProgram = 0;
+GLProgram quadsTextShaderProgram;
 GLint shaderViewport2;
 GLint shaderTextureSampler2;
 
@@ -37,10 +65,13 @@ const GLchar* quadsTextVertexSource =
     "uniform vec2 viewport;                                     \n"
     "attribute vec4 position;                                   \n"
     "attribute vec2 texCoord;                                   \n"
+    "attribute vec2 offset;                                     \n"
     "varying vec2 vTexCoord;                                    \n"    
     "void main()                                                \n"
     "{                                                          \n"
+    "    // Strings are cached at the origin, offset per draw   \n"
     "    gl_Position = vec4(position.xyz, 1.0);                 \n"
+    "    gl_Position.xy += offset;                              \n"
     "                                                           \n"
     "    // Ortho projection                                    \n"
     "    gl_Position.x += 1.0;                                  \n"
@@ -51,11 +82,60 @@ const GLchar* quadsTextVertexSource =
     "    vTexCoord = texCoord;                                  \n"  
     "}                                                          \n";
 
+// GPU laid out text vertex shader: a quad per glyph instance, from the glyph's metrics texels
+GLProgram glyphsTextShaderProgram;
+GLint shaderViewport3, shaderFontTexSize, shaderGlyphMetrics, shaderTextureSampler3;
+
+const GLchar* glyphsTextVertexSource =
+    "uniform vec2 viewport;                                     \n"
+    "uniform vec2 fontTexSize;                                  \n"
+    "uniform sampler2D glyphMetrics;                            \n"
+    "attribute vec2 corner;                                     \n"
+    "attribute vec2 pen;                                        \n"
+    "attribute float glyph;                                     \n"
+    "varying vec2 vTexCoord;                                    \n"
+    "void main()                                                \n"
+    "{                                                          \n"
+    "    // Texel 2g: quad offset + 128 and size, 2g+1: atlas   \n"
+    "    // position as low, high bytes (512x1 texture)         \n"
+    "    vec2 texel = vec2((glyph * 2.0 + 0.5) / 512.0, 0.5);   \n"
+    "    vec4 quad = floor(texture2D(glyphMetrics, texel)       \n"
+    "                      * 255.0 + 0.5);                      \n"
+    "    texel.x += 1.0 / 512.0;                                \n"
+    "    vec4 atlas = floor(texture2D(glyphMetrics, texel)      \n"
+    "                       * 255.0 + 0.5);                     \n"
+    "    vec2 size = quad.zw * corner;                          \n"
+    "                                                           \n"
+    "    vec2 position = pen + quad.xy - 128.0 + size;          \n"
+    "    gl_Position = vec4(position, 0.0, 1.0);                \n"
+    "    vTexCoord = (atlas.xz + atlas.yw * 256.0 + size + 0.5) \n"
+    "                / fontTexSize;                             \n"
+    "                                                           \n"
+    "    // Ortho projection                                    \n"
+    "    gl_Position.x += 1.0;                                  \n"
+    "    gl_Position.x *= 2.0 / viewport.x;                     \n"
+    "    gl_Position.y += 1.0;                                  \n"
+    "    gl_Position.y *= 2.0 / viewport.y;                     \n"
+    "}                                                          \n";
+
+// Dynamic text, typed out a character at a time and laid out each frame
+const char* cTypedText = "OPENGL TEXT\nON DEMAND";
+Uint32 typingStartTicks = 0;
+
 // Font quad texture, geometry, and vertex shader
 const char* cFontName = "media/rockfont.txf";
-TexFont* texFont = nullptr;
-GLuint quadFontVbo = 0;
-GLuint quadFontShaderProgram = 0;
+TexFont* texFont = nullptr; // Set once the font texture is uploaded
+TexFont* loadedFont = nullptr; // Loaded on a worker, handed to texFont by the upload
+AssetManifest manifest({ cFontName });
+AssetLoader* fontLoader = nullptr;
+int benchmarkGlyphs = 0;
+int fontTextureHandle = -1; // The font texture is re-established from the font's bitmap if evicted
+bool useMipmaps = true;
+bool assertNoHeap = false;
+bool atlasReport = false;
+unsigned int textFrames = 0;
+GLBuffer quadFontVbo;
+GLProgram quadFontShaderProgram;
 GLfloat fontSize[2] = {0.0f, 0.0f};
 GLint shaderViewport, shaderFontSize, shaderTextureSampler;
 const GLchar* quadFontVertexSource =
@@ -98,11 +178,13 @@ const GLchar* fontFragmentSource =
     "}                                                          \n";
 
 // Colorful triangle geometry, vertex & fragment shaders
-GLuint triangleVbo = 0;
-GLuint triShaderProgram = 0;
-GLint shaderPan, shaderZoom, shaderAspect;
+GLBuffer triangleVbo;
+const double triangleWorld[] = { 0.0, 0.5,  -0.5, -0.5,  0.5, -0.5 }; // Uploaded relative to the eye by updateGeometry()
+const WorldRect triangleBounds = {-0.5, -0.5, 0.5, 0.5};
+bool sceneChanged = true; // Since the last frame drawn, other than by the camera
+GLProgram triShaderProgram;
+GLint shaderZoom, shaderAspect;
 const GLchar* triVertexSource =
-    "uniform vec2 pan;                             \n"
     "uniform float zoom;                           \n"
     "uniform float aspect;                         \n"
     "attribute vec4 position;                      \n"
@@ -110,7 +192,6 @@ const GLchar* triVertexSource =
     "void main()                                   \n"
     "{                                             \n"
     "    gl_Position = vec4(position.xyz, 1.0);    \n"
-    "    gl_Position.xy += pan;                    \n"
     "    gl_Position.xy *= zoom;                   \n"
     "    gl_Position.y *= aspect;                  \n"
     "    color = gl_Position.xyz + vec3(0.5);      \n"
@@ -137,39 +218,42 @@ void updateShader(EventHandler& eventHandler)
     glUniform2fv(shaderFontSize, 1, fontSize);
     glUniform1i(shaderTextureSampler, 0);
 
+    if (glyphsTextShaderProgram != 0)
+    {
+        glUseProgram(glyphsTextShaderProgram);
+        glUniform2fv(shaderViewport3, 1, camera.viewport());
+        glUniform2fv(shaderFontTexSize, 1, fontSize);
+        glUniform1i(shaderGlyphMetrics, 1);
+        glUniform1i(shaderTextureSampler3, 0);
+    }
+
     glUseProgram(triShaderProgram);
-    glUniform2fv(shaderPan, 1, camera.pan());
     glUniform1f(shaderZoom, camera.zoom()); 
     glUniform1f(shaderAspect, camera.aspect());
 }
 
-GLuint buildShaderProgram(const GLchar* vertexSource, const GLchar* fragmentSource, bool bUseTexCoords)
+GLProgram buildShaderProgram(const GLchar* vertexSource, const GLchar* fragmentSource, const std::vector<const char*>& attributes)
 {
     // Create and compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
-    glCompileShader(vertexShader);
+    GLShader vertexShader = GLShader::compile(GL_VERTEX_SHADER, vertexSource);
 
     // Create and compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-    glCompileShader(fragmentShader);
+    GLShader fragmentShader = GLShader::compile(GL_FRAGMENT_SHADER, fragmentSource);
 
-    // Link vertex and fragment shader into shader program
-    GLuint shaderProgram = glCreateProgram();
+    // Link vertex and fragment shader into shader program.  The shaders are deleted on return, once linked.
+    GLProgram shaderProgram = GLProgram::create();
     glAttachShader(shaderProgram, vertexShader);
     glAttachShader(shaderProgram, fragmentShader);
-    glBindAttribLocation(shaderProgram, vertexPositionIndex, "position");
-    if (bUseTexCoords)
-        glBindAttribLocation(shaderProgram, vertexTexCoordIndex, "texCoord");
+    for (size_t i = 0; i < attributes.size(); ++i)
+        glBindAttribLocation(shaderProgram, (GLuint)i, attributes[i]);
     
     glLinkProgram(shaderProgram);
 
     GLenum glError = glGetError();
     if (glError != GL_NO_ERROR)
-        printf("ERROR: Shader %d failed to build, error code %d\n", shaderProgram, glError);
+        printf("ERROR: Shader %d failed to build, error code %d\n", shaderProgram.id(), glError);
     else
-        printf("Shader %d built OK.\n", shaderProgram);
+        printf("Shader %d built OK.\n", shaderProgram.id());
 
     return shaderProgram;
 }
@@ -177,9 +261,9 @@ GLuint buildShaderProgram(const GLchar* vertexSource, const GLchar* fragmentSour
 void initShaders(EventHandler& eventHandler)
 {
     // Compile & link shaders
-    quadsTextShaderProgram = buildShaderProgram(quadsTextVertexSource, fontFragmentSource, true);
-    quadFontShaderProgram = buildShaderProgram(quadFontVertexSource, fontFragmentSource, false);
-    triShaderProgram = buildShaderProgram(triVertexSource, triFragmentSource, false);
+    quadsTextShaderProgram = buildShaderProgram(quadsTextVertexSource, fontFragmentSource, {"position", "texCoord", "offset"});
+    quadFontShaderProgram = buildShaderProgram(quadFontVertexSource, fontFragmentSource, {"position"});
+    triShaderProgram = buildShaderProgram(triVertexSource, triFragmentSource, {"position"});
 
     // Get shader uniforms and initialize them
     shaderViewport2 = glGetUniformLocation(quadsTextShaderProgram, "viewport");
@@ -189,18 +273,38 @@ void initShaders(EventHandler& eventHandler)
     shaderFontSize = glGetUniformLocation(quadFontShaderProgram, "fontSize");
     shaderTextureSampler = glGetUniformLocation(quadFontShaderProgram, "texSampler");
 
-    shaderPan = glGetUniformLocation(triShaderProgram, "pan");
     shaderZoom = glGetUniformLocation(triShaderProgram, "zoom");    
     shaderAspect = glGetUniformLocation(triShaderProgram, "aspect");
 
     updateShader(eventHandler);
 }
 
-void initGeometry()
+// The GPU text layout program, if the font could set up GPU layout
+void initGlyphsShader(EventHandler& eventHandler)
+{
+    glyphsTextShaderProgram = buildShaderProgram(glyphsTextVertexSource, fontFragmentSource, {"corner", "pen", "glyph"});
+
+    shaderViewport3 = glGetUniformLocation(glyphsTextShaderProgram, "viewport");
+    shaderFontTexSize = glGetUniformLocation(glyphsTextShaderProgram, "fontTexSize");
+    shaderGlyphMetrics = glGetUniformLocation(glyphsTextShaderProgram, "glyphMetrics");
+    shaderTextureSampler3 = glGetUniformLocation(glyphsTextShaderProgram, "texSampler");
+
+    updateShader(eventHandler);
+}
+
+void updateGeometry(EventHandler& eventHandler)
+{
+    // Rebase the triangle's world coords relative to the eye and copy them into its vertex buffer
+    GLfloat vertices[sizeof(triangleWorld) / sizeof(double)];
+    eventHandler.camera().worldToEyeRelative(triangleWorld, vertices, 3);
+    glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+}
+
+void initGeometry(EventHandler& eventHandler)
 {
    // Create vertex buffer objects and copy vertex data into them
-    glGenBuffers(1, &quadFontVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, quadFontVbo);
+    quadFontVbo = GLBuffer::create();
     GLfloat quadVertices[] = 
     {
         0.0f, 1.0f, 0.0f,
@@ -208,17 +312,11 @@ void initGeometry()
         0.0f, 0.0f, 0.0f,
         1.0f, 0.0f, 0.0f
     };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    quadFontVbo.data(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
 
-    glGenBuffers(1, &triangleVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
-    GLfloat triangleVertices[] = 
-    {
-        0.0f, 0.5f, 0.0f,
-        -0.5f, -0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f
-    };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(triangleVertices), triangleVertices, GL_STATIC_DRAW);  
+    triangleVbo = GLBuffer::create();
+    triangleVbo.data(GL_ARRAY_BUFFER, sizeof(triangleWorld) / sizeof(double) * sizeof(GLfloat), nullptr, GL_DYNAMIC_DRAW);
+    updateGeometry(eventHandler);
  }
 
 void debugPrintSurface(SDL_Surface* surface, const char* name, bool dumpPixels)
@@ -232,9 +330,81 @@ void debugPrintSurface(SDL_Surface* surface, const char* name, bool dumpPixels)
     }
 }
 
+void loadFont()
+{
+    loadedFont = txfLoadFont(cFontName);
+
+    // Mipmaps are built with the font, off the GL thread
+    MipStats stats;
+    if (loadedFont && useMipmaps && txfBuildMipmaps(loadedFont, &stats))
+        printf("INFO: Font mipmaps, %d levels (%d without glyphs sharing texels), %.1f KB built in %.2f ms\n",
+               stats.levels, stats.separateLevels, stats.bytes / 1024.0, stats.buildMs);
+}
+
+// Time txfBuildGlyphRun on a string of random glyphs from the font, as vertex generation throughput, and
+// txfLayoutText on the same string, with the bytes each uploads per glyph
+void benchmarkGlyphRuns(int glyphCount)
+{
+    std::vector<char> glyphs;
+    for (int c = 0; c < 256; ++c)
+        if (texFont->glyphTable->present[c] && c != ' ')
+            glyphs.push_back((char)c);
+    if (glyphs.empty() || glyphCount <= 0)
+        return;
+
+    std::vector<char> text(glyphCount + 1, 0);
+    for (int i = 0; i < glyphCount; ++i)
+        text[i] = glyphs[rand() % glyphs.size()];
+    std::vector<GLfloat> vertices((size_t)glyphCount * 6 * 5);
+
+    // Repeat to about 10M glyphs per measurement
+    const int repeats = std::max(1, 10000000 / glyphCount);
+    for (bool parallel : {false, true})
+    {
+        txfBuildGlyphRun(texFont, text.data(), glyphCount, vertices.data(), parallel);
+
+        Uint64 startCounter = SDL_GetPerformanceCounter();
+        for (int i = 0; i < repeats; ++i)
+            txfBuildGlyphRun(texFont, text.data(), glyphCount, vertices.data(), parallel);
+        double ms = (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency() / repeats;
+
+        printf("INFO: Glyph run of %d glyphs built in %.3f ms on %d threads, %.1f M glyphs/s\n", glyphCount, ms,
+               parallel ? ThreadPool::shared().threadCount() : 1, ms > 0.0 ? glyphCount / ms / 1000.0 : 0.0);
+    }
+
+    std::vector<TexGlyphInstance> instances(glyphCount);
+    Uint64 startCounter = SDL_GetPerformanceCounter();
+    for (int i = 0; i < repeats; ++i)
+        txfLayoutText(texFont, text.data(), 0.0f, 0.0f, instances.data());
+    double ms = (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency() / repeats;
+
+    printf("INFO: GPU layout of %d glyphs in %.3f ms, %.1f M glyphs/s, uploading %d bytes per glyph rather than %d\n", 
+           glyphCount, ms, ms > 0.0 ? glyphCount / ms / 1000.0 : 0.0, (int)sizeof(TexGlyphInstance), (int)(6 * 5 * sizeof(GLfloat)));
+}
+
+// Pack the font's glyph images into a texture atlas the size of the font texture, a realistic image set of
+// many small, mixed size rects, and compare its efficiency with the layout the font was made with
+void reportGlyphAtlas()
+{
+    const int pageSize = std::max(texFont->tex_width, texFont->tex_height);
+    TextureAtlas glyphAtlas(pageSize, 1, GL_ALPHA);
+    double glyphArea = 0.0;
+    for (int i = 0; i < texFont->num_glyphs; ++i)
+    {
+        const TexGlyphInfo& glyph = texFont->tgi[i];
+        if (glyph.width == 0 || glyph.height == 0)
+            continue;
+        glyphAtlas.add(texFont->teximage + glyph.y * texFont->tex_width + glyph.x, glyph.width, glyph.height, texFont->tex_width);
+        glyphArea += (double)glyph.width * glyph.height;
+    }
+    glyphAtlas.build(GL_NEAREST);
+
+    printf("INFO: Font layout %d glyphs in %dx%d, %.1f%% used\n", texFont->num_glyphs, texFont->tex_width, texFont->tex_height,
+           glyphArea * 100.0 / ((double)texFont->tex_width * texFont->tex_height));
+}
+
 void initFontTexture(EventHandler& eventHandler)
 {
-    texFont = txfLoadFont(cFontName);
     if (texFont)
     {
         printf("texFont dimensions %dx%d\n", texFont->tex_width, texFont->tex_height);
@@ -250,7 +420,8 @@ void initFontTexture(EventHandler& eventHandler)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        // Trilinear minification when mipmapped, so zoomed out text doesn't shimmer
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texFont->mipLevels.empty() ? GL_NEAREST : GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
         fontSize[0] = (GLfloat)texFont->tex_width;
@@ -265,6 +436,7 @@ void initFontTexture(EventHandler& eventHandler)
 
 void destroyFontTexture()
 {
+    TextureManager::shared().remove(fontTextureHandle);
     txfUnloadFont(texFont);
 }
 
@@ -276,52 +448,150 @@ void redraw(EventHandler& eventHandler)
     // All shaders use position geometry, so enable it here
     glEnableVertexAttribArray(vertexPositionIndex);
 
-    // Draw a triangle with a colorful shader
-    glUseProgram(triShaderProgram);
-    glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
-    glVertexAttribPointer(vertexPositionIndex, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    // Draw a triangle with a colorful shader, unless culled
+    if (eventHandler.camera().isVisible(triangleBounds))
+    {
+        glUseProgram(triShaderProgram);
+        glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
+        glVertexAttribPointer(vertexPositionIndex, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
 
     // Draw a texture atlas quad with a font texture shader
+    glBindTexture(GL_TEXTURE_2D, TextureManager::shared().use(fontTextureHandle));
     glUseProgram(quadFontShaderProgram);
     glBindBuffer(GL_ARRAY_BUFFER, quadFontVbo);
     glVertexAttribPointer(vertexPositionIndex, 3, GL_FLOAT, GL_FALSE, 0, 0);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
     // Draw text string quads with a text shader
+    txfBeginFrame(texFont);
     glEnableVertexAttribArray(vertexTexCoordIndex);
     glUseProgram(quadsTextShaderProgram);
     txfRenderString(texFont, "OpenGL", -64.0f * 2.5f, 0.0f);
     txfRenderString(texFont, "3D", -64.0f, -64.0f * 1.5f);
+    txfRenderString(texFont, "3D", 64.0f * 1.5f, -64.0f * 1.5f); // Same cached string, another place
     glDisableVertexAttribArray(vertexTexCoordIndex);
+
+    // Draw typed text in the lower left, laid out on the GPU if possible, else streamed as quads
+    if (texFont)
+    {
+        const int typedLength = (int)strlen(cTypedText), charMs = 150;
+        int typed = (int)((SDL_GetTicks() - typingStartTicks) / charMs % (typedLength + 10));
+        char text[32];
+        snprintf(text, sizeof(text), "%.*s", std::min(typed, typedLength), cTypedText);
+
+        const GLfloat* viewport = eventHandler.camera().viewport();
+        glUseProgram(texFont->gpuLayout ? glyphsTextShaderProgram : quadsTextShaderProgram);
+        txfRenderText(texFont, text, -viewport[0] / 2.0f + 16.0f, -viewport[1] / 2.0f + 16.0f + texFont->max_ascent + texFont->max_descent);
+    }
    
     // Done with position geometry
     glDisableVertexAttribArray(vertexPositionIndex);
 
-    // Swap front/back framebuffers
+    // Swap front/back framebuffers, publish this frame's culling counts, then evict textures not drawn this frame if over budget
     eventHandler.swapWindow();
+    eventHandler.camera().endCullFrame();
+    TextureManager::shared().endFrame();
 }
 
 void mainLoop(void* mainLoopArg) 
 {    
     EventHandler& eventHandler = *((EventHandler*)mainLoopArg);
+    const unsigned int frameStartAllocations = HeapCounter::allocations();
     eventHandler.processEvents();
+    manifest.update();
+
+    // Once the font texture is uploaded, set up glyph layout and hand the texture to the texture manager
+    if (fontLoader && fontLoader->update())
+    {
+        fontLoader->printTimeline();
+        delete fontLoader;
+        fontLoader = nullptr;
+        if (texFont && benchmarkGlyphs > 0)
+            benchmarkGlyphRuns(benchmarkGlyphs);
+        if (texFont && atlasReport)
+            reportGlyphAtlas();
+        if (texFont && txfInitGpuLayout(texFont))
+            initGlyphsShader(eventHandler);
+        typingStartTicks = SDL_GetTicks();
+        if (texFont)
+            fontTextureHandle = TextureManager::shared().add(cFontName, texFont->texobj, [&]() { initFontTexture(eventHandler); });
+    }
 
-    // Update shader if camera changed
-    if (eventHandler.camera().updated())
+    // Update shader and geometry if camera changed
+    bool cameraUpdated = eventHandler.camera().updated();
+    if (cameraUpdated)
+    {
         updateShader(eventHandler);
+        updateGeometry(eventHandler);
+    }
+
+    // Nothing moved and nothing is loading; once the font is here, the typed text animates, so the last frame drawn is still on screen
+    if (!cameraUpdated && !sceneChanged && !fontLoader && !texFont && eventHandler.idle())
+        eventHandler.skipFrame();
+    else
+    {
+        redraw(eventHandler);
+        sceneChanged = false;
+    }
+
+    // The first text frame caches its strings and may overflow the arena, growing it on reset; steady state frames
+    // must neither call operator new nor overflow the arena
+    if (assertNoHeap && texFont && ++textFrames > 1)
+    {
+        unsigned int frameAllocations = HeapCounter::allocations() - frameStartAllocations;
+        if (frameAllocations != 0)
+            printf("ERROR: Text frame %u made %u heap allocations\n", textFrames, frameAllocations);
+        SDL_assert_release(frameAllocations == 0 && FrameArena::frame().stats().heapAllocations == 0);
+    }
 
-    redraw(eventHandler);
+    // Free this frame's transient allocations
+    FrameArena::frame().reset();
 }
 
 int main(int argc, char** argv)
 {
-    EventHandler eventHandler("Hello TXF Text");
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--glyph-benchmark") && i + 1 < argc)
+            benchmarkGlyphs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-mipmaps"))
+            useMipmaps = false;
+        else if (!strcmp(argv[i], "--atlas-report"))
+            atlasReport = true;
+        else if (!strcmp(argv[i], "--assert-no-heap"))
+            assertNoHeap = true;
+    }
+
+    if (assertNoHeap && !HeapCounter::enabled())
+        printf("INFO: Built without -DCOUNT_HEAP_ALLOCATIONS, so --assert-no-heap checks frame arena overflows only\n");
 
-    // Initialize graphics
-    initShaders(eventHandler);
-    initGeometry();
-    initFontTexture(eventHandler);
+    EventHandler eventHandler("Hello TXF Text", argc, argv);
+    TextureManager::shared().parseArgs(argc, argv);
+    eventHandler.addReportSection(GLResource::writeReport);
+    eventHandler.addReportSection([](char* buffer, size_t size) { return TextureManager::shared().writeReport(buffer, size); });
+
+    // Initialize graphics while the font is fetched. Once it's here, it's read and its bitmap expanded on a worker.
+    manifest.request(cFontName, [&](bool fetched)
+    {
+        if (!fetched)
+        {
+            printf("ERROR: No %s, drawing without text\n", cFontName);
+            return;
+        }
+        fontLoader = new AssetLoader();
+        fontLoader->add(cFontName, loadFont, nullptr, [&]() { texFont = loadedFont; initFontTexture(eventHandler); });
+        fontLoader->start();
+    });
+    AssetLoader assets;
+    assets.add("shaders", nullptr, nullptr, [&]() { initShaders(eventHandler); });
+    assets.add("geometry", nullptr, nullptr, [&]() { initGeometry(eventHandler); });
+    assets.run();
+    assets.printTimeline();
+    GLResource::printReport("after init");
+    TextureManager::shared().printReport("after init");
+    manifest.printReport("after init");
 
     // Start the main loop
     void* mainLoopArg = &eventHandler;
@@ -5,13 +5,27 @@
 //     Install emscripten: http://kripken.github.io/emscripten-site/docs/getting_started/downloads.html
 //
 // Build on Mac/Linux:
-//     emcc -std=c++11 hello_texture.cpp events.cpp camera.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s SDL2_IMAGE_FORMATS='["png"]' -s FULL_ES2=1 -s WASM=0 --preload-file media/texmap.png -o hello_texture.html
+//     emcc -std=c++11 hello_texture.cpp events.cpp camera.cpp assets.cpp threadpool.cpp glresource.cpp texturemanager.cpp pixels.cpp pngstream.cpp texcompress.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s USE_LIBPNG=1 -s SDL2_IMAGE_FORMATS='["png"]' -s FULL_ES2=1 -s WASM=0 -o hello_texture.html
 // Build on Windows:
-//     emcc -std=c++11 hello_texture.cpp events.cpp camera.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s SDL2_IMAGE_FORMATS="[""png""]" -s FULL_ES2=1 -s WASM=0 --preload-file media/texmap.png -o hello_texture.html
+//     emcc -std=c++11 hello_texture.cpp events.cpp camera.cpp assets.cpp threadpool.cpp glresource.cpp texturemanager.cpp pixels.cpp pngstream.cpp texcompress.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s USE_LIBPNG=1 -s SDL2_IMAGE_FORMATS="[""png""]" -s FULL_ES2=1 -s WASM=0 -o hello_texture.html
+//
+// Build with the SSE2 pixel kernels, as WebAssembly SIMD (Emscripten 2.0 or newer; the asm.js builds above are scalar):
+//     emcc -std=c++11 -msimd128 -msse2 hello_texture.cpp events.cpp camera.cpp assets.cpp threadpool.cpp glresource.cpp texturemanager.cpp pixels.cpp pngstream.cpp texcompress.cpp -s USE_SDL=2 -s USE_SDL_IMAGE=2 -s USE_LIBPNG=1 -s SDL2_IMAGE_FORMATS='["png"]' -s FULL_ES2=1 -s WASM=1 -o hello_texture_simd.html
 // 
 // Run:
 //     emrun hello_texture.html
 //
+//     media/texmap.png is fetched on demand from next to the page, so serve the page from this directory.
+//
+// Options:
+//     --pixel-benchmark <megapixels>   Time each pixel conversion kernel over this many pixels, SIMD and scalar
+//                                      (SIMD natively and in the -msimd128 -msse2 build, scalar in the asm.js builds)
+//     --stream-png                     Decode the PNG progressively, a chunk of the file per frame, uploading each
+//                                      band of rows as it completes, instead of decoding it whole on a worker
+//     --compress <format>              Encode the texture to BC1 blocks once, then transcode them on load to s3tc,
+//                                      etc1 or rgb565, or auto for the best format the GPU supports (not with
+//                                      --stream-png, and only for opaque images)
+//
 // Result:
 //     A textured triangle.  Left mouse pans, mouse wheel zooms in/out.  Window is resizable.
 //
@@ -25,15 +39,54 @@
 #include <SDL_opengles2.h>
 
 #include "events.h"
+#include "assets.h"
+#include "glresource.h"
+#include "texturemanager.h"
+#include "pixels.h"
+#include "pngstream.h"
+#include "texcompress.h"
+
+#ifndef __EMSCRIPTEN__
+#include <sys/resource.h>
+#endif
 
 // Texture
 const char* cTextureFilename = "media/texmap.png";
-GLuint textureObj = 0;
+AssetManifest manifest({ cTextureFilename });
+GLTexture textureObj;
+int textureHandle = -1;
+std::vector<unsigned char> textureFile; // Kept to re-decode the texture if it's evicted
+std::vector<unsigned char> texturePixels; // Decoded image, converted to RGBA for upload
+int textureWidth = 0, textureHeight = 0;
+Uint64 textureStartCounter = 0;
+
+// Compressed texture: the BC1 blocks are the intermediate format, encoded once and kept, as if they'd been built offline,
+// and transcoded to the GPU's format on every (re)load
+bool compressTexture = false;
+const char* compressedFormatOptions[CompressedFormatCount] = { "s3tc", "etc1", "rgb565" };
+CompressedFormat textureFormat = CompressedRGB565;
+CompressedImage textureBlocks;
+std::vector<unsigned char> textureTranscoded; // Transcoded blocks or texels, ready for upload
+
+// Streamed PNG decode, on the GL thread: the texture is allocated from the header, and filled in a band at a time
+bool streamPng = false;
+const int cStreamBandRows = 64;
+const size_t cStreamChunkBytes = 32 * 1024; // File bytes decoded per frame
+PngStream* textureStream = nullptr;
+AssetLoader* textureLoader = nullptr; // Decoding on a worker, until uploaded
+SDL_RWops* textureStreamFile = nullptr;
+Uint64 firstPixelsCounter = 0;
+int streamFrames = 0, streamBands = 0;
+
+// Geometry
+GLBuffer triangleVbo;
+const double triangleWorld[] = { 0.0, 0.5,  -0.5, -0.5,  0.5, -0.5 }; // Uploaded relative to the eye by updateGeometry()
+const WorldRect triangleBounds = {-0.5, -0.5, 0.5, 0.5};
+bool sceneChanged = true; // Since the last frame drawn, other than by the camera
 
 // Vertex shader
-GLint shaderPan, shaderZoom, shaderAspect;
+GLint shaderZoom, shaderAspect;
 const GLchar* vertexSource =
-    "uniform vec2 pan;                                   \n"
     "uniform float zoom;                                 \n"
     "uniform float aspect;                               \n"
     "attribute vec4 position;                            \n"
@@ -41,7 +94,6 @@ const GLchar* vertexSource =
     "void main()                                         \n"
     "{                                                   \n"
     "    gl_Position = vec4(position.xyz, 1.0);          \n"
-    "    gl_Position.xy += pan;                          \n"
     "    gl_Position.xy *= zoom;                         \n"
     "    texCoord = vec2(gl_Position.x, -gl_Position.y); \n"
     "    gl_Position.y *= aspect;                        \n"
@@ -61,32 +113,26 @@ void updateShader(EventHandler& eventHandler)
 {
     Camera& camera = eventHandler.camera();
 
-    glUniform2fv(shaderPan, 1, camera.pan());
     glUniform1f(shaderZoom, camera.zoom()); 
     glUniform1f(shaderAspect, camera.aspect());
 }
 
-GLuint initShader(EventHandler& eventHandler)
+GLProgram initShader(EventHandler& eventHandler)
 {
     // Create and compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
-    glCompileShader(vertexShader);
+    GLShader vertexShader = GLShader::compile(GL_VERTEX_SHADER, vertexSource);
 
     // Create and compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-    glCompileShader(fragmentShader);
+    GLShader fragmentShader = GLShader::compile(GL_FRAGMENT_SHADER, fragmentSource);
 
-    // Link vertex and fragment shader into shader program and use it
-    GLuint shaderProgram = glCreateProgram();
+    // Link vertex and fragment shader into shader program and use it.  The shaders are deleted on return, once linked.
+    GLProgram shaderProgram = GLProgram::create();
     glAttachShader(shaderProgram, vertexShader);
     glAttachShader(shaderProgram, fragmentShader);
     glLinkProgram(shaderProgram);
     glUseProgram(shaderProgram);
 
     // Get shader variables and initalize them
-    shaderPan = glGetUniformLocation(shaderProgram, "pan");
     shaderZoom = glGetUniformLocation(shaderProgram, "zoom");    
     shaderAspect = glGetUniformLocation(shaderProgram, "aspect");
     updateShader(eventHandler);
@@ -94,74 +140,292 @@ GLuint initShader(EventHandler& eventHandler)
     return shaderProgram;
 }
 
-void initGeometry(GLuint shaderProgram)
+void updateGeometry(EventHandler& eventHandler)
+{
+    // Rebase the triangle's world coords relative to the eye and copy them into its vertex buffer
+    GLfloat vertices[sizeof(triangleWorld) / sizeof(double)];
+    eventHandler.camera().worldToEyeRelative(triangleWorld, vertices, 3);
+    glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+}
+
+void initGeometry(EventHandler& eventHandler, GLuint shaderProgram)
 {
     // Create vertex buffer object and copy vertex data into it
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    GLfloat triangleVertices[] = 
-    {
-        0.0f, 0.5f, 0.0f,
-        -0.5f, -0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f
-    };    
-    glBufferData(GL_ARRAY_BUFFER, sizeof(triangleVertices), triangleVertices, GL_STATIC_DRAW);
-
-    // Specify the layout of the shader vertex data (positions only, 3 floats)
+    triangleVbo = GLBuffer::create();
+    triangleVbo.data(GL_ARRAY_BUFFER, sizeof(triangleWorld) / sizeof(double) * sizeof(GLfloat), nullptr, GL_DYNAMIC_DRAW);
+    updateGeometry(eventHandler);
+
+    // Specify the layout of the shader vertex data (positions only, 2 floats)
     GLint posAttrib = glGetAttribLocation(shaderProgram, "position");
     glEnableVertexAttribArray(posAttrib);
-    glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribPointer(posAttrib, 2, GL_FLOAT, GL_FALSE, 0, 0);
 }
 
-void initTexture()
+// Peak resident set size in KB natively (ru_maxrss is in KB on Linux, bytes on macOS), 0 in the browser
+long peakRssKB()
+{
+#ifdef __EMSCRIPTEN__
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#endif
+}
+
+double msSince(Uint64 startCounter)
+{
+    return (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+void readTextureFile()
 {
-    SDL_Surface *image = IMG_Load(cTextureFilename);
+    readFile(cTextureFilename, textureFile);
+}
 
-    if (!image)
+// BC1 as encoded here is opaque, so images with alpha stay RGBA
+void encodeTexture()
+{
+    for (size_t i = 3; i < texturePixels.size(); i += 4)
     {
-        // Create a fallback gray texture
-        printf("Failed to load %s, due to %s\n", cTextureFilename, IMG_GetError());
-        const int w = 128, h = 128, bitsPerPixel = 24;
-        image = SDL_CreateRGBSurface(0, w, h, bitsPerPixel, 0, 0, 0, 0);
-        if (image)
-            memset(image->pixels, 0x42, image->w * image->h * bitsPerPixel / 8);
+        if (texturePixels[i] != 255)
+        {
+            printf("INFO: Texture has alpha, uploading it uncompressed\n");
+            return;
+        }
     }
 
-    if (image)
+    Uint64 startCounter = SDL_GetPerformanceCounter();
+    encodeBC1(texturePixels.data(), textureWidth, textureHeight, textureBlocks);
+    printf("INFO: Texture encoded to BC1 in %.2f ms, %.1f KB (an offline step, done once)\n", msSince(startCounter),
+           textureBlocks.blocks.size() / 1024.0);
+    texturePixels.clear();
+}
+
+void transcodeTexture()
+{
+    Uint64 startCounter = SDL_GetPerformanceCounter();
+    transcodeBC1(textureBlocks, textureFormat, textureTranscoded);
+    double ms = msSince(startCounter);
+    printf("INFO: Texture transcoded from BC1 to %s in %.2f ms, %.0f MP/s\n", compressedFormatName(textureFormat), ms,
+           ms > 0.0 ? textureWidth * textureHeight / ms / 1000.0 : 0.0);
+}
+
+void decodeTexture()
+{
+    // Reloads of a compressed texture only transcode its blocks
+    if (compressTexture && !textureBlocks.blocks.empty())
     {
-        int bitsPerPixel = image->format->BitsPerPixel;
-        printf ("Image dimensions %dx%d, %d bits per pixel\n", image->w, image->h, bitsPerPixel);
+        transcodeTexture();
+        return;
+    }
 
-        // Determine GL texture format
-        GLint format = -1;
-        if (bitsPerPixel == 24)
-            format = GL_RGB;
-        else if (bitsPerPixel == 32)
-            format = GL_RGBA;
+    SDL_Surface *image = IMG_Load_RW(SDL_RWFromConstMem(textureFile.data(), (int)textureFile.size()), 1);
 
-        if (format != -1)
+    if (image)
+    {
+        // Convert whatever format the image decoded to into RGBA, repacked to tight rows
+        Uint64 startCounter = SDL_GetPerformanceCounter();
+        if (convertSurfaceToRGBA(image, texturePixels))
         {
-            // Generate a GL texture object
-            glGenTextures(1, &textureObj);
+            textureWidth = image->w;
+            textureHeight = image->h;
+            printf("INFO: Image %dx%d, %s, converted to RGBA in %.2f ms with %s kernels\n", image->w, image->h,
+                   SDL_GetPixelFormatName(image->format->format),
+                   (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency(), pixelsSimdName());
+        }
+        else
+            printf("Failed to convert %s, due to %s\n", cTextureFilename, SDL_GetError());
+        SDL_FreeSurface(image);
+    }
+    else
+        printf("Failed to load %s, due to %s\n", cTextureFilename, IMG_GetError());
+
+    if (texturePixels.empty())
+    {
+        // Create a fallback gray texture
+        textureWidth = textureHeight = 128;
+        texturePixels.assign(textureWidth * textureHeight * 4, 0x42);
+    }
+
+    if (compressTexture)
+    {
+        encodeTexture();
+        if (!textureBlocks.blocks.empty())
+            transcodeTexture();
+    }
+}
+
+void createTexture()
+{
+    // Generate a GL texture object
+    textureObj = GLTexture::create();
+
+    // Bind GL texture
+    glBindTexture(GL_TEXTURE_2D, textureObj);
+
+    // Set the GL texture's wrapping and stretching properties
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void initTexture()
+{
+    if (!textureTranscoded.empty())
+    {
+        createTexture();
+        uploadCompressed(textureObj, 0, textureFormat, textureWidth, textureHeight, textureTranscoded);
+        size_t rgbaBytes = (size_t)textureWidth * textureHeight * 4;
+        printf("INFO: Texture uploaded as %s, first pixels after %.2f ms, %.1f KB on the GPU vs %.1f KB RGBA, %.1fx smaller\n",
+               compressedFormatName(textureFormat), msSince(textureStartCounter), textureObj.bytes() / 1024.0,
+               rgbaBytes / 1024.0, textureObj.bytes() ? (double)rgbaBytes / textureObj.bytes() : 0.0);
+
+        textureTranscoded.clear();
+    }
+    else if (!texturePixels.empty())
+    {
+        printf ("Image dimensions %dx%d, RGBA\n", textureWidth, textureHeight);
+        createTexture();
+
+        // Copy the converted image to GL texture
+        textureObj.image2D(0, GL_RGBA, textureWidth, textureHeight, GL_UNSIGNED_BYTE, texturePixels.data());
+        printf("INFO: Texture decoded whole, first pixels after %.2f ms, %.1f KB decoded, peak RSS %ld KB\n",
+               msSince(textureStartCounter), texturePixels.size() / 1024.0, peakRssKB());
 
-            // Bind GL texture
-            glBindTexture(GL_TEXTURE_2D, textureObj);
+        texturePixels.clear();
+    }
+}
+
+void reloadTexture()
+{
+    textureStartCounter = SDL_GetPerformanceCounter();
+    decodeTexture();
+    initTexture();
+}
 
-            // Set the GL texture's wrapping and stretching properties
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+// Stop streaming, and let the texture manager evict the texture again
+void finishTextureStream()
+{
+    delete textureStream;
+    textureStream = nullptr;
+    if (textureStreamFile)
+        SDL_RWclose(textureStreamFile);
+    textureStreamFile = nullptr;
+    TextureManager::shared().setEvictable(textureHandle, true);
+}
 
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// Texture manager loader in --stream-png mode. The texture exists from the start, and is allocated and filled in
+// as the stream decodes over the following frames, pinned resident so band uploads never land on an evicted texture.
+void startTextureStream()
+{
+    finishTextureStream();
+    TextureManager::shared().setEvictable(textureHandle, false);
+    textureStartCounter = SDL_GetPerformanceCounter();
+    firstPixelsCounter = 0;
+    streamFrames = streamBands = 0;
+
+    createTexture();
+    textureStreamFile = SDL_RWFromFile(cTextureFilename, "rb");
+    textureStream = new PngStream(cStreamBandRows,
+        [](int width, int height)
+        {
+            textureWidth = width;
+            textureHeight = height;
+            textureObj.image2D(0, GL_RGBA, width, height, GL_UNSIGNED_BYTE, nullptr);
+        },
+        [](int row, int rows, const unsigned char* rgba)
+        {
+            textureObj.subImage2D(0, 0, row, textureWidth, rows, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+            if (!firstPixelsCounter)
+                firstPixelsCounter = SDL_GetPerformanceCounter();
+            streamBands++;
+        });
+}
+
+void feedTextureStream()
+{
+    unsigned char chunk[cStreamChunkBytes];
+    size_t size = textureStreamFile ? SDL_RWread(textureStreamFile, chunk, 1, sizeof(chunk)) : 0;
+    streamFrames++;
+    if (size == 0 || !textureStream->feed(chunk, size))
+    {
+        // Not a PNG that streams (e.g. interlaced), or cut short: decode it whole instead
+        printf("Failed to stream %s, decoding it whole\n", cTextureFilename);
+        finishTextureStream();
+        readTextureFile();
+        reloadTexture();
+    }
+    else if (textureStream->done())
+    {
+        printf("INFO: Texture streamed, first pixels after %.2f ms, complete after %.2f ms over %d frames in %d bands, "
+               "%.1f KB band vs %.1f KB decoded whole, peak RSS %ld KB\n",
+               (firstPixelsCounter - textureStartCounter) * 1000.0 / SDL_GetPerformanceFrequency(), msSince(textureStartCounter),
+               streamFrames, streamBands, textureStream->bandBytes() / 1024.0, textureWidth * textureHeight * 4 / 1024.0,
+               peakRssKB());
+        finishTextureStream();
+    }
+}
 
-            // Copy SDL surface image to GL texture
-            glTexImage2D(GL_TEXTURE_2D, 0, format, image->w, image->h, 0,
-                         format, GL_UNSIGNED_BYTE, image->pixels);
+// Time each conversion kernel over megapixels of random pixels, with SIMD and with the scalar paths
+void benchmarkPixelKernels(int megapixels)
+{
+    int count = megapixels << 20;
+    std::vector<unsigned char> src((size_t)count * 4), dst((size_t)count * 4);
+    for (unsigned char& c : src)
+        c = (unsigned char)rand();
+    unsigned int palette[256];
+    for (unsigned int& entry : palette)
+        entry = (unsigned int)rand();
+
+    struct Kernel { const char* name; std::function<void()> run; };
+    Kernel kernels[] =
+    {
+        { "BGRA swizzle", [&]() { pixelsSwizzleRB(src.data(), dst.data(), count); } },
+        { "RGB expand", [&]() { pixelsExpandRGB(src.data(), dst.data(), count); } },
+        { "palette expand", [&]() { pixelsExpandPalette(src.data(), dst.data(), count, palette); } },
+        { "premultiply", [&]() { pixelsPremultiply(dst.data(), count); } },
+    };
+    for (bool simd : {true, false})
+    {
+        pixelsEnableSimd(simd);
+        for (const Kernel& kernel : kernels)
+        {
+            const int repeats = 5;
+            Uint64 startCounter = SDL_GetPerformanceCounter();
+            for (int i = 0; i < repeats; ++i)
+                kernel.run();
+            double ms = (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency() / repeats;
+            printf("INFO: Pixel kernel %s (%s), %d MP in %.2f ms, %.0f MB/s written\n", kernel.name, pixelsSimdName(),
+                   megapixels, ms, ms > 0.0 ? count * 4.0 / ms / 1000.0 : 0.0);
         }
-                                 
-        SDL_FreeSurface (image);        
-    }                       
+    }
+    pixelsEnableSimd(true);
+}
+
+// Once the texture file is here, start decoding it on a worker, or stream it
+void textureFetched(bool fetched)
+{
+    if (!fetched)
+    {
+        printf("ERROR: No %s, drawing untextured\n", cTextureFilename);
+        return;
+    }
+
+    if (streamPng)
+    {
+        // Streaming starts when the texture is first used, and it stays resident until the stream is done
+        textureHandle = TextureManager::shared().add(cTextureFilename, textureObj, startTextureStream, false);
+        sceneChanged = true;
+        return;
+    }
+
+    textureLoader = new AssetLoader();
+    textureLoader->add(cTextureFilename, readTextureFile, decodeTexture, initTexture);
+    textureLoader->start();
 }
 
 void redraw(EventHandler& eventHandler)
@@ -169,33 +433,118 @@ void redraw(EventHandler& eventHandler)
     // Clear screen
     glClear(GL_COLOR_BUFFER_BIT);
 
-    // Draw the vertex buffer
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    // Draw the vertex buffer, unless culled
+    if (eventHandler.camera().isVisible(triangleBounds))
+    {
+        glBindTexture(GL_TEXTURE_2D, TextureManager::shared().use(textureHandle));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
 
-    // Swap front/back framebuffers
+    // Swap front/back framebuffers, publish this frame's culling counts, then evict textures not drawn this frame if over budget
     eventHandler.swapWindow();
+    eventHandler.camera().endCullFrame();
+    TextureManager::shared().endFrame();
 }
 
 void mainLoop(void* mainLoopArg) 
 {    
     EventHandler& eventHandler = *((EventHandler*)mainLoopArg);
     eventHandler.processEvents();
+    manifest.update();
+
+    // Upload the texture once it's decoded, and hand it to the texture manager
+    if (textureLoader && textureLoader->update())
+    {
+        textureLoader->printTimeline();
+        delete textureLoader;
+        textureLoader = nullptr;
+        textureHandle = TextureManager::shared().add(cTextureFilename, textureObj, reloadTexture);
+        sceneChanged = true;
+    }
 
-    // Update shader if camera changed
-    if (eventHandler.camera().updated())
+    // Decode the next chunk of a streamed texture
+    if (textureStream)
+    {
+        feedTextureStream();
+        sceneChanged = true;
+    }
+
+    // Update shader and geometry if camera changed
+    bool cameraUpdated = eventHandler.camera().updated();
+    if (cameraUpdated)
+    {
         updateShader(eventHandler);
+        updateGeometry(eventHandler);
+    }
 
-    redraw(eventHandler);
+    // Nothing moved and nothing is loading, so the last frame drawn is still on screen
+    if (!cameraUpdated && !sceneChanged && !textureLoader && eventHandler.idle())
+        eventHandler.skipFrame();
+    else
+    {
+        redraw(eventHandler);
+        sceneChanged = false;
+    }
 }
 
 int main(int argc, char** argv)
 {
-    EventHandler eventHandler("Hello Texture");
+    int benchmarkMegapixels = 0;
+    const char* compressFormatOption = "auto";
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--pixel-benchmark") && i + 1 < argc)
+            benchmarkMegapixels = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--stream-png"))
+            streamPng = true;
+        else if (!strcmp(argv[i], "--compress") && i + 1 < argc)
+        {
+            compressTexture = true;
+            compressFormatOption = argv[++i];
+        }
+    }
+
+    EventHandler eventHandler("Hello Texture", argc, argv);
+    TextureManager::shared().parseArgs(argc, argv);
+    eventHandler.addReportSection(GLResource::writeReport);
+    eventHandler.addReportSection([](char* buffer, size_t size) { return TextureManager::shared().writeReport(buffer, size); });
+
+    // Pick the compressed format once there's a GL context to ask, falling back from any the GPU can't sample
+    if (compressTexture && streamPng)
+    {
+        printf("INFO: --compress isn't supported with --stream-png, uploading RGBA\n");
+        compressTexture = false;
+    }
+    if (compressTexture)
+    {
+        textureFormat = selectCompressedFormat();
+        for (int format = 0; format < CompressedFormatCount; ++format)
+        {
+            if (strcmp(compressFormatOption, compressedFormatOptions[format]))
+                continue;
+            if (compressedFormatSupported((CompressedFormat)format))
+                textureFormat = (CompressedFormat)format;
+            else
+                printf("INFO: %s textures aren't supported, using %s\n", compressedFormatOptions[format],
+                       compressedFormatName(textureFormat));
+        }
+        printf("INFO: Compressed textures uploaded as %s\n", compressedFormatName(textureFormat));
+    }
     
-    // Initialize shader, geometry, and texture
-    GLuint shaderProgram = initShader(eventHandler);
-    initGeometry(shaderProgram);
-    initTexture();
+    // Initialize shader and geometry, while the texture is fetched. Frames are drawn untextured until it's here.
+    textureStartCounter = SDL_GetPerformanceCounter();
+    manifest.request(cTextureFilename, textureFetched);
+    GLProgram shaderProgram;
+    AssetLoader assets;
+    int shader = assets.add("shader", nullptr, nullptr, [&]() { shaderProgram = initShader(eventHandler); });
+    assets.add("geometry", nullptr, nullptr, [&]() { initGeometry(eventHandler, shaderProgram); }, {shader});
+    assets.run();
+    assets.printTimeline();
+    if (benchmarkMegapixels > 0)
+        benchmarkPixelKernels(benchmarkMegapixels);
+    GLResource::printReport("after init");
+    TextureManager::shared().printReport("after init");
+    manifest.printReport("after init");
 
     // Start the main loop
     void* mainLoopArg = &eventHandler;
@@ -208,7 +557,5 @@ int main(int argc, char** argv)
         mainLoop(mainLoopArg);
 #endif
 
-    glDeleteTextures(1, &textureObj);
-
     return 0;
 }
\ No newline at end of file
@@ -5,11 +5,15 @@
 //     Install emscripten: http://kripken.github.io/emscripten-site/docs/getting_started/downloads.html
 //
 // Build:
-//     emcc -std=c++11 hello_triangle.cpp events.cpp camera.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=0 -o hello_triangle.html
+//     emcc -std=c++11 hello_triangle.cpp events.cpp camera.cpp glresource.cpp -s USE_SDL=2 -s FULL_ES2=1 -s WASM=0 -o hello_triangle.html
 //
 // Run:
 //     emrun hello_triangle.html
 //
+// Options:
+//     --transform-benchmark <points>   Time converting this many window points to world coords one at a time, against
+//                                      the camera's batch conversions, and print the speed-up
+//
 // Result:
 //     A colorful triangle.  Left mouse pans, mouse wheel zooms in/out.  Window is resizable.
 //
@@ -18,15 +22,29 @@
 #include <emscripten.h>
 #endif
 
+#include <math.h>
+#include <vector>
 #include <SDL.h>
 #include <SDL_opengles2.h>
 
 #include "events.h"
+#include "glresource.h"
+
+// Geometry, in double precision world coords.  Uploaded relative to the eye (camera pan already applied), 
+// so the shader only sees small float offsets and deep zooms don't jitter.
+GLBuffer triangleVbo;
+const double triangleWorld[] = 
+{
+    0.0, 0.5,
+    -0.5, -0.5,
+    0.5, -0.5
+};
+const WorldRect triangleBounds = {-0.5, -0.5, 0.5, 0.5};
+bool sceneChanged = true; // Since the last frame drawn, other than by the camera
 
 // Vertex shader
-GLint shaderPan, shaderZoom, shaderAspect;
+GLint shaderZoom, shaderAspect;
 const GLchar* vertexSource =
-    "uniform vec2 pan;                             \n"
     "uniform float zoom;                           \n"
     "uniform float aspect;                         \n"
     "attribute vec4 position;                      \n"
@@ -34,7 +52,6 @@ const GLchar* vertexSource =
     "void main()                                   \n"
     "{                                             \n"
     "    gl_Position = vec4(position.xyz, 1.0);    \n"
-    "    gl_Position.xy += pan;                    \n"
     "    gl_Position.xy *= zoom;                   \n"
     "    gl_Position.y *= aspect;                  \n"
     "    color = gl_Position.xyz + vec3(0.5);      \n"
@@ -53,32 +70,26 @@ void updateShader(EventHandler& eventHandler)
 {
     Camera& camera = eventHandler.camera();
 
-    glUniform2fv(shaderPan, 1, camera.pan());
     glUniform1f(shaderZoom, camera.zoom()); 
     glUniform1f(shaderAspect, camera.aspect());
 }
 
-GLuint initShader(EventHandler& eventHandler)
+GLProgram initShader(EventHandler& eventHandler)
 {
     // Create and compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
-    glCompileShader(vertexShader);
+    GLShader vertexShader = GLShader::compile(GL_VERTEX_SHADER, vertexSource);
 
     // Create and compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-    glCompileShader(fragmentShader);
+    GLShader fragmentShader = GLShader::compile(GL_FRAGMENT_SHADER, fragmentSource);
 
-    // Link vertex and fragment shader into shader program and use it
-    GLuint shaderProgram = glCreateProgram();
+    // Link vertex and fragment shader into shader program and use it.  The shaders are deleted on return, once linked.
+    GLProgram shaderProgram = GLProgram::create();
     glAttachShader(shaderProgram, vertexShader);
     glAttachShader(shaderProgram, fragmentShader);
     glLinkProgram(shaderProgram);
     glUseProgram(shaderProgram);
 
     // Get shader variables and initialize them
-    shaderPan = glGetUniformLocation(shaderProgram, "pan");
     shaderZoom = glGetUniformLocation(shaderProgram, "zoom");    
     shaderAspect = glGetUniformLocation(shaderProgram, "aspect");
     updateShader(eventHandler);
@@ -86,24 +97,26 @@ GLuint initShader(EventHandler& eventHandler)
     return shaderProgram;
 }
 
-void initGeometry(GLuint shaderProgram)
+void updateGeometry(EventHandler& eventHandler)
+{
+    // Rebase world coords relative to the eye and copy them into the vertex buffer
+    GLfloat vertices[sizeof(triangleWorld) / sizeof(double)];
+    eventHandler.camera().worldToEyeRelative(triangleWorld, vertices, 3);
+    glBindBuffer(GL_ARRAY_BUFFER, triangleVbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+}
+
+void initGeometry(EventHandler& eventHandler, GLuint shaderProgram)
 {
     // Create vertex buffer object and copy vertex data into it
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    GLfloat vertices[] = 
-    {
-        0.0f, 0.5f, 0.0f,
-        -0.5f, -0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f
-    };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    triangleVbo = GLBuffer::create();
+    triangleVbo.data(GL_ARRAY_BUFFER, sizeof(triangleWorld) / sizeof(double) * sizeof(GLfloat), nullptr, GL_DYNAMIC_DRAW);
+    updateGeometry(eventHandler);
 
-    // Specify the layout of the shader vertex data (positions only, 3 floats)
+    // Specify the layout of the shader vertex data (positions only, 2 floats)
     GLint posAttrib = glGetAttribLocation(shaderProgram, "position");
     glEnableVertexAttribArray(posAttrib);
-    glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribPointer(posAttrib, 2, GL_FLOAT, GL_FALSE, 0, 0);
 }
 
 void redraw(EventHandler& eventHandler)
@@ -111,11 +124,13 @@ void redraw(EventHandler& eventHandler)
     // Clear screen
     glClear(GL_COLOR_BUFFER_BIT);
 
-    // Draw the vertex buffer
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    // Draw the vertex buffer, unless culled
+    if (eventHandler.camera().isVisible(triangleBounds))
+        glDrawArrays(GL_TRIANGLES, 0, 3);
 
-    // Swap front/back framebuffers
+    // Swap front/back framebuffers and publish this frame's culling counts
     eventHandler.swapWindow();
+    eventHandler.camera().endCullFrame();
 }
 
 void mainLoop(void* mainLoopArg) 
@@ -123,20 +138,80 @@ void mainLoop(void* mainLoopArg)
     EventHandler& eventHandler = *((EventHandler*)mainLoopArg);
     eventHandler.processEvents();
 
-    // Update shader if camera changed
-    if (eventHandler.camera().updated())
+    // Update shader and geometry if camera changed
+    bool cameraUpdated = eventHandler.camera().updated();
+    if (cameraUpdated)
+    {
         updateShader(eventHandler);
+        updateGeometry(eventHandler);
+    }
 
-    redraw(eventHandler);
+    // Nothing moved, so the last frame drawn is still on screen
+    if (!cameraUpdated && !sceneChanged && eventHandler.idle())
+        eventHandler.skipFrame();
+    else
+    {
+        redraw(eventHandler);
+        sceneChanged = false;
+    }
+}
+
+// Time the per-point window to world conversion over random window points against the batch conversion, and the
+// batch conversion back to window coords
+void benchmarkTransforms(Camera& camera, int count)
+{
+    std::vector<float> winX(count), winY(count), worldX(count), worldY(count), backX(count), backY(count);
+    std::vector<double> scalarX(count), scalarY(count);
+    for (int i = 0; i < count; ++i)
+    {
+        winX[i] = (float)(rand() % camera.windowSize().width);
+        winY[i] = (float)(rand() % camera.windowSize().height);
+    }
+
+    auto ms = [](Uint64 startCounter) { return (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency(); };
+    Uint64 startCounter = SDL_GetPerformanceCounter();
+    for (int i = 0; i < count; ++i)
+        camera.windowToWorldCoords((int)winX[i], (int)winY[i], scalarX[i], scalarY[i]);
+    double scalarMs = ms(startCounter);
+
+    startCounter = SDL_GetPerformanceCounter();
+    camera.windowToWorldCoords(winX.data(), winY.data(), worldX.data(), worldY.data(), count);
+    double batchMs = ms(startCounter);
+
+    startCounter = SDL_GetPerformanceCounter();
+    camera.worldToWindowCoords(worldX.data(), worldY.data(), backX.data(), backY.data(), count);
+    double inverseMs = ms(startCounter);
+
+    // Batch results are single precision, so check how far they are from the double precision path
+    double maxError = 0.0, maxRoundTrip = 0.0;
+    for (int i = 0; i < count; ++i)
+    {
+        maxError = fmax(maxError, fmax(fabs(worldX[i] - scalarX[i]), fabs(worldY[i] - scalarY[i])));
+        maxRoundTrip = fmax(maxRoundTrip, fmax(fabs(backX[i] - winX[i]), fabs(backY[i] - winY[i])));
+    }
+    printf("INFO: Window to world, %d points: per point %.2f ms, batch %.2f ms, %.1fx faster (max error %g world units)\n",
+           count, scalarMs, batchMs, batchMs > 0.0 ? scalarMs / batchMs : 0.0, maxError);
+    printf("INFO: World to window, %d points: batch %.2f ms (max round trip error %g pixels)\n", count, inverseMs, maxRoundTrip);
 }
 
 int main(int argc, char** argv)
 {
-    EventHandler eventHandler("Hello Triangle");
+    int benchmarkPoints = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--transform-benchmark") && i + 1 < argc)
+            benchmarkPoints = atoi(argv[++i]);
+    }
+
+    EventHandler eventHandler("Hello Triangle", argc, argv);
+    eventHandler.addReportSection(GLResource::writeReport);
 
     // Initialize shader and geometry
-    GLuint shaderProgram = initShader(eventHandler);
-    initGeometry(shaderProgram);
+    GLProgram shaderProgram = initShader(eventHandler);
+    initGeometry(eventHandler, shaderProgram);
+    GLResource::printReport("after init");
+    if (benchmarkPoints > 0)
+        benchmarkTransforms(eventHandler.camera(), benchmarkPoints);
 
     // Start the main loop
     void* mainLoopArg = &eventHandler;
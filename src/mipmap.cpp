@@ -0,0 +1,99 @@
+//
+// Atlas mipmaps - mip chains for atlases of separately drawn images such as font glyphs, downsampling each image
+// only from its own texels, so minified images don't bleed into each other across the gutters between them
+//
+#include <stdio.h>
+#include <algorithm>
+#include <SDL.h>
+#include "mipmap.h"
+
+// #define MIPMAP_DEBUG
+
+std::vector<MipLevel> buildAtlasMipmaps(const unsigned char* pixels, int width, int height, int pitch, int bytesPerPixel,
+                                        const std::vector<MipRect>& rects, MipStats* stats)
+{
+    Uint64 startCounter = SDL_GetPerformanceCounter();
+    std::vector<MipLevel> levels;
+
+    // Rects in the level being downsampled, as [x0,x1) x [y0,y1)
+    struct Span { int x0, y0, x1, y1; };
+    std::vector<Span> spans;
+    for (const MipRect& rect : rects)
+        spans.push_back({ std::max(0, rect.x), std::max(0, rect.y),
+                          std::min(width, rect.x + rect.width), std::min(height, rect.y + rect.height) });
+
+    const unsigned char* source = pixels;
+    int sourceWidth = width, sourceHeight = height, sourcePitch = pitch;
+    int separateLevels = 0;
+    bool separate = true;
+    std::vector<int> owner;
+    while (sourceWidth > 1 || sourceHeight > 1)
+    {
+        MipLevel level;
+        level.width = std::max(1, sourceWidth / 2);
+        level.height = std::max(1, sourceHeight / 2);
+        level.pixels.assign((size_t)level.width * level.height * bytesPerPixel, 0);
+        owner.assign((size_t)level.width * level.height, -1);
+
+        for (size_t r = 0; r < spans.size(); ++r)
+        {
+            Span& span = spans[r];
+            if (span.x0 >= span.x1 || span.y0 >= span.y1)
+                continue;
+            Span target = { span.x0 / 2, span.y0 / 2,
+                            std::min(level.width, (span.x1 + 1) / 2), std::min(level.height, (span.y1 + 1) / 2) };
+
+            for (int y = target.y0; y < target.y1; ++y)
+                for (int x = target.x0; x < target.x1; ++x)
+                {
+                    // The 2x2 (or 1 wide or high, once a side reaches 1) source block, clipped to the rect
+                    int sx0 = std::max(span.x0, sourceWidth > 1 ? x * 2 : x);
+                    int sx1 = std::min(span.x1, sourceWidth > 1 ? x * 2 + 2 : x + 1);
+                    int sy0 = std::max(span.y0, sourceHeight > 1 ? y * 2 : y);
+                    int sy1 = std::min(span.y1, sourceHeight > 1 ? y * 2 + 2 : y + 1);
+                    int count = (sx1 - sx0) * (sy1 - sy0);
+                    if (count <= 0)
+                        continue;
+
+                    unsigned char* texel = &level.pixels[((size_t)y * level.width + x) * bytesPerPixel];
+                    for (int c = 0; c < bytesPerPixel; ++c)
+                    {
+                        int sum = 0;
+                        for (int sy = sy0; sy < sy1; ++sy)
+                            for (int sx = sx0; sx < sx1; ++sx)
+                                sum += source[(size_t)sy * sourcePitch + sx * bytesPerPixel + c];
+                        texel[c] = std::max(texel[c], (unsigned char)((sum + count / 2) / count));
+                    }
+
+                    int& texelOwner = owner[(size_t)y * level.width + x];
+                    if (texelOwner != -1 && texelOwner != (int)r)
+                        separate = false;
+                    texelOwner = (int)r;
+                }
+            span = target;
+        }
+
+        if (separate)
+            separateLevels++;
+        levels.push_back(std::move(level));
+        source = levels.back().pixels.data();
+        sourceWidth = levels.back().width;
+        sourceHeight = levels.back().height;
+        sourcePitch = sourceWidth * bytesPerPixel;
+
+        #ifdef MIPMAP_DEBUG
+            printf("mip level %d %dx%d%s\n", (int)levels.size(), sourceWidth, sourceHeight, separate ? "" : ", rects share texels");
+        #endif
+    }
+
+    if (stats)
+    {
+        stats->levels = (int)levels.size();
+        stats->separateLevels = separateLevels;
+        stats->bytes = 0;
+        for (const MipLevel& level : levels)
+            stats->bytes += level.pixels.size();
+        stats->buildMs = (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency();
+    }
+    return levels;
+}
@@ -0,0 +1,23 @@
+//
+// Atlas mipmaps - mip chains for atlases of separately drawn images such as font glyphs, downsampling each image
+// only from its own texels, so minified images don't bleed into each other across the gutters between them
+//
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+// An image's rectangle in the atlas, in level 0 texels
+struct MipRect { int x, y, width, height; };
+
+// A mip level, rows tightly packed
+struct MipLevel { int width, height; std::vector<unsigned char> pixels; };
+
+struct MipStats { int levels, separateLevels; size_t bytes; double buildMs; };
+
+// Build levels 1 and on, down to 1x1, of a width x height atlas of 1 (GL_ALPHA) or 4 (GL_RGBA) byte texels with rows
+// pitch bytes apart. Each rect covers half as many texels (rounded out) per level, and each of its texels is the box
+// filtered average of the texels it covers in the level above that are inside the rect, clamping to the rect's edge.
+// Texels outside every rect are 0. Once gutters run out, rects share texels, which take the maximum of each.
+// Doesn't use GL, so it can run on a worker at atlas build time.
+std::vector<MipLevel> buildAtlasMipmaps(const unsigned char* pixels, int width, int height, int pitch, int bytesPerPixel,
+                                        const std::vector<MipRect>& rects, MipStats* stats = nullptr);
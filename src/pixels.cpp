@@ -0,0 +1,287 @@
+//
+// Pixel conversion - converts decoded images to tightly packed RGBA for texture upload, with SIMD kernels
+// (SSE2 or NEON natively; SSE2 as WebAssembly SIMD in Emscripten builds with -msimd128 -msse2) and scalar fallbacks
+//
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+#include "pixels.h"
+#include "threadpool.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXELS_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PIXELS_NEON 1
+#endif
+
+// #define PIXELS_DEBUG
+
+static bool simdEnabled = true;
+
+const char* pixelsSimdName()
+{
+#if defined(PIXELS_SSE2)
+    return simdEnabled ? "SSE2" : "scalar";
+#elif defined(PIXELS_NEON)
+    return simdEnabled ? "NEON" : "scalar";
+#else
+    return "scalar";
+#endif
+}
+
+void pixelsEnableSimd(bool enable)
+{
+    simdEnabled = enable;
+}
+
+void pixelsSwizzleRB(const unsigned char* src, unsigned char* dst, int count)
+{
+    int i = 0;
+#if defined(PIXELS_SSE2)
+    if (simdEnabled)
+    {
+        // Swap the R and B bytes of each 32 bit pixel by shifting them past each other
+        const __m128i gaMask = _mm_set1_epi32((int)0xff00ff00), rbMask = _mm_set1_epi32(0x00ff00ff);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+            __m128i rb = _mm_and_si128(v, rbMask);
+            rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+            _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_and_si128(v, gaMask), rb));
+        }
+    }
+#elif defined(PIXELS_NEON)
+    if (simdEnabled)
+    {
+        for (; i + 16 <= count; i += 16)
+        {
+            uint8x16x4_t v = vld4q_u8(src + i * 4);
+            uint8x16_t r = v.val[0];
+            v.val[0] = v.val[2];
+            v.val[2] = r;
+            vst4q_u8(dst + i * 4, v);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const unsigned char* s = src + i * 4;
+        unsigned char r = s[0], g = s[1], b = s[2], a = s[3];
+        unsigned char* d = dst + i * 4;
+        d[0] = b;
+        d[1] = g;
+        d[2] = r;
+        d[3] = a;
+    }
+}
+
+void pixelsExpandRGB(const unsigned char* src, unsigned char* dst, int count)
+{
+    int i = 0;
+#if defined(PIXELS_SSE2)
+    if (simdEnabled)
+    {
+        // Without SSSE3's byte shuffle, gather 4 pixels with 32 bit loads 3 bytes apart, and set each top byte to
+        // alpha. The 4th pixel's load reads the byte after it, so stop a pixel early.
+        const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+        for (; i + 5 <= count; i += 4)
+        {
+            const unsigned char* s = src + i * 3;
+            int p0, p1, p2, p3;
+            memcpy(&p0, s, 4);
+            memcpy(&p1, s + 3, 4);
+            memcpy(&p2, s + 6, 4);
+            memcpy(&p3, s + 9, 4);
+            _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_set_epi32(p3, p2, p1, p0), alpha));
+        }
+    }
+#elif defined(PIXELS_NEON)
+    if (simdEnabled)
+    {
+        const uint8x16_t alpha = vdupq_n_u8(255);
+        for (; i + 16 <= count; i += 16)
+        {
+            uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+            uint8x16x4_t rgba = {{ rgb.val[0], rgb.val[1], rgb.val[2], alpha }};
+            vst4q_u8(dst + i * 4, rgba);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const unsigned char* s = src + i * 3;
+        unsigned char* d = dst + i * 4;
+        d[0] = s[0];
+        d[1] = s[1];
+        d[2] = s[2];
+        d[3] = 255;
+    }
+}
+
+// No gather in SSE2 or NEON, so this is scalar, a 32 bit load and store per pixel
+void pixelsExpandPalette(const unsigned char* src, unsigned char* dst, int count, const unsigned int* palette)
+{
+    for (int i = 0; i < count; ++i)
+        memcpy(dst + i * 4, &palette[src[i]], 4);
+}
+
+// c * a / 255, rounded, exactly
+static inline unsigned char multiply255(unsigned int c, unsigned int a)
+{
+    unsigned int t = c * a + 128;
+    return (unsigned char)((t + (t >> 8)) >> 8);
+}
+
+void pixelsPremultiply(unsigned char* rgba, int count)
+{
+    int i = 0;
+#if defined(PIXELS_SSE2)
+    if (simdEnabled)
+    {
+        // 4 pixels as 16 bit channels, 2 per register, multiplied by their alpha broadcast across their channels
+        const __m128i zero = _mm_setzero_si128(), half = _mm_set1_epi16(128);
+        const __m128i alphaMask = _mm_set1_epi32((int)0xff000000);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+            __m128i channels[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+            for (__m128i& c : channels)
+            {
+                __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+                __m128i t = _mm_add_epi16(_mm_mullo_epi16(c, a), half);
+                c = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+            }
+            __m128i result = _mm_packus_epi16(channels[0], channels[1]);
+            result = _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(alphaMask, v));
+            _mm_storeu_si128((__m128i*)(rgba + i * 4), result);
+        }
+    }
+#elif defined(PIXELS_NEON)
+    if (simdEnabled)
+    {
+        const uint16x8_t half = vdupq_n_u16(128);
+        for (; i + 16 <= count; i += 16)
+        {
+            uint8x16x4_t v = vld4q_u8(rgba + i * 4);
+            uint8x16_t a = v.val[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                uint16x8_t lo = vaddq_u16(vmull_u8(vget_low_u8(v.val[c]), vget_low_u8(a)), half);
+                uint16x8_t hi = vaddq_u16(vmull_u8(vget_high_u8(v.val[c]), vget_high_u8(a)), half);
+                v.val[c] = vcombine_u8(vshrn_n_u16(vaddq_u16(lo, vshrq_n_u16(lo, 8)), 8),
+                                       vshrn_n_u16(vaddq_u16(hi, vshrq_n_u16(hi, 8)), 8));
+            }
+            vst4q_u8(rgba + i * 4, v);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        unsigned char* p = rgba + i * 4;
+        p[0] = multiply255(p[0], p[3]);
+        p[1] = multiply255(p[1], p[3]);
+        p[2] = multiply255(p[2], p[3]);
+    }
+}
+
+void pixelsShuffle(const unsigned char* src, unsigned char* dst, int count, int bytesPerPixel, const int offsets[4])
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const unsigned char* s = src + i * bytesPerPixel;
+        unsigned char* d = dst + i * 4;
+        for (int c = 0; c < 4; ++c)
+            d[c] = offsets[c] >= 0 ? s[offsets[c]] : 255;
+    }
+}
+
+// Byte offset of a channel within a pixel, -1 if the channel is missing, or -2 if it isn't a whole byte
+static int channelOffset(Uint32 mask, int bytesPerPixel)
+{
+    if (mask == 0)
+        return -1;
+    for (int byte = 0; byte < bytesPerPixel; ++byte)
+        if (mask == (Uint32)0xff << (byte * 8))
+            return SDL_BYTEORDER == SDL_LIL_ENDIAN ? byte : bytesPerPixel - 1 - byte;
+    return -2;
+}
+
+bool convertSurfaceToRGBA(SDL_Surface* surface, std::vector<unsigned char>& staging, bool premultiply)
+{
+    SDL_PixelFormat* format = surface->format;
+    int bytesPerPixel = format->BytesPerPixel;
+    int offsets[4] = { -2, -2, -2, -2 };
+    if (bytesPerPixel == 3 || bytesPerPixel == 4)
+    {
+        offsets[0] = channelOffset(format->Rmask, bytesPerPixel);
+        offsets[1] = channelOffset(format->Gmask, bytesPerPixel);
+        offsets[2] = channelOffset(format->Bmask, bytesPerPixel);
+        offsets[3] = channelOffset(format->Amask, bytesPerPixel);
+    }
+    bool paletted = format->BitsPerPixel == 8 && format->palette;
+    bool byteAligned = offsets[0] >= 0 && offsets[1] >= 0 && offsets[2] >= 0 && offsets[3] != -2;
+
+    // Anything else (16 bit, 1 and 4 bit paletted, ...) is rare, so let SDL convert it to RGBA bytes first
+    if (!paletted && !byteAligned)
+    {
+        #ifdef PIXELS_DEBUG
+            printf("converting %s with SDL\n", SDL_GetPixelFormatName(format->format));
+        #endif
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+        if (!converted)
+            return false;
+        bool result = convertSurfaceToRGBA(converted, staging, premultiply);
+        SDL_FreeSurface(converted);
+        return result;
+    }
+
+    // Paletted: a 256 entry table, as SDL_Colors are RGBA bytes, with the color key transparent
+    unsigned int palette[256] = {};
+    if (paletted)
+    {
+        memcpy(palette, format->palette->colors, SDL_min(format->palette->ncolors, 256) * sizeof(SDL_Color));
+        Uint32 key;
+        if (SDL_GetColorKey(surface, &key) == 0 && key < 256)
+            ((unsigned char*)&palette[key])[3] = 0;
+    }
+
+    int width = surface->w, height = surface->h;
+    staging.resize((size_t)width * height * 4);
+    if (SDL_MUSTLOCK(surface))
+        SDL_LockSurface(surface);
+
+    const unsigned char* pixels = (const unsigned char*)surface->pixels;
+    unsigned char* rgba = staging.data();
+    int pitch = surface->pitch;
+    bool hasAlpha = paletted || offsets[3] >= 0;
+    ThreadPool::shared().parallelFor(0, height, 64, [&](int rowBegin, int rowEnd)
+    {
+        // Rows without padding between them convert as one run
+        int runs = pitch == width * bytesPerPixel ? 1 : rowEnd - rowBegin;
+        int count = runs == 1 ? width * (rowEnd - rowBegin) : width;
+        for (int run = 0; run < runs; ++run)
+        {
+            const unsigned char* src = pixels + (size_t)(rowBegin + run) * pitch;
+            unsigned char* dst = rgba + (size_t)(rowBegin + run) * width * 4;
+            if (paletted)
+                pixelsExpandPalette(src, dst, count, palette);
+            else if (bytesPerPixel == 4 && offsets[0] == 0 && offsets[1] == 1 && offsets[2] == 2 && offsets[3] == 3)
+                memcpy(dst, src, (size_t)count * 4);
+            else if (bytesPerPixel == 4 && offsets[0] == 2 && offsets[1] == 1 && offsets[2] == 0 && offsets[3] == 3)
+                pixelsSwizzleRB(src, dst, count);
+            else if (bytesPerPixel == 3 && offsets[0] == 0 && offsets[1] == 1 && offsets[2] == 2)
+                pixelsExpandRGB(src, dst, count);
+            else
+                pixelsShuffle(src, dst, count, bytesPerPixel, offsets);
+
+            if (premultiply && hasAlpha)
+                pixelsPremultiply(dst, count);
+        }
+    });
+
+    if (SDL_MUSTLOCK(surface))
+        SDL_UnlockSurface(surface);
+    return true;
+}
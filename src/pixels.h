@@ -0,0 +1,30 @@
+//
+// Pixel conversion - converts decoded images to tightly packed RGBA for texture upload, with SIMD kernels
+// (SSE2 or NEON natively; SSE2 as WebAssembly SIMD in Emscripten builds with -msimd128 -msse2) and scalar fallbacks
+//
+// Requires SDL.h to be included first.
+//
+#pragma once
+#include <vector>
+
+// Convert an SDL surface of any format to RGBA rows of width * 4 bytes in staging, ready for glTexImage2D with
+// GL_RGBA. 32 and 24 bit formats with byte aligned channels in any order, and 8 bit paletted formats (with their
+// color key, if any, made transparent), are converted by the kernels below; other formats go through
+// SDL_ConvertSurfaceFormat first. Rows are converted in parallel on the shared thread pool. Returns false if the
+// surface can't be converted.
+bool convertSurfaceToRGBA(SDL_Surface* surface, std::vector<unsigned char>& staging, bool premultiply = false);
+
+// Kernels over count pixels. src and dst may be the same buffer for the 4 byte to 4 byte kernels.
+void pixelsSwizzleRB(const unsigned char* src, unsigned char* dst, int count);          // BGRA <-> RGBA
+void pixelsExpandRGB(const unsigned char* src, unsigned char* dst, int count);          // RGB to RGBA, alpha 255
+void pixelsExpandPalette(const unsigned char* src, unsigned char* dst, int count,       // 8 bit indices to RGBA,
+                         const unsigned int* palette);                                  // 256 RGBA entries
+void pixelsPremultiply(unsigned char* rgba, int count);                                 // In place, alpha kept
+
+// Any byte order: offsets[0..3] are the source byte of R, G, B and A in each pixel of bytesPerPixel, or -1 for 255.
+// Scalar only.
+void pixelsShuffle(const unsigned char* src, unsigned char* dst, int count, int bytesPerPixel, const int offsets[4]);
+
+// Kernel instruction set ("SSE2", "NEON" or "scalar"), and a switch to the scalar paths for comparison
+const char* pixelsSimdName();
+void pixelsEnableSimd(bool enable);
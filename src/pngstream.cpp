@@ -0,0 +1,107 @@
+//
+// PNG stream - progressive PNG decoding with libpng, handing out RGBA rows a band at a time as the file's bytes
+// arrive, so large images can be uploaded while they decode, in bounded memory
+//
+#include <stdio.h>
+#include <string.h>
+#include <png.h>
+#include "pngstream.h"
+
+// #define PNGSTREAM_DEBUG
+
+struct PngStreamCallbacks
+{
+    static void info(png_structp png, png_infop info)
+    {
+        PngStream* stream = (PngStream*)png_get_progressive_ptr(png);
+        png_uint_32 width, height;
+        int bitDepth, colorType, interlace;
+        png_get_IHDR(png, info, &width, &height, &bitDepth, &colorType, &interlace, nullptr, nullptr);
+        if (interlace != PNG_INTERLACE_NONE)
+            png_error(png, "interlaced images can't be streamed in bands");
+
+        // Everything to 8 bit RGBA: palettes and low bit depth gray expanded, transparency to alpha, 16 bit
+        // channels stripped, gray to RGB, and opaque alpha added where there's none
+        png_set_expand(png);
+        png_set_strip_16(png);
+        if (colorType == PNG_COLOR_TYPE_GRAY || colorType == PNG_COLOR_TYPE_GRAY_ALPHA)
+            png_set_gray_to_rgb(png);
+        png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
+        png_read_update_info(png, info);
+
+        stream->mWidth = (int)width;
+        stream->mHeight = (int)height;
+        stream->mBand.resize((size_t)width * 4 * stream->mBandRows);
+        #ifdef PNGSTREAM_DEBUG
+            printf("png %ux%u, bit depth %d, color type %d, %d row bands\n", width, height, bitDepth, colorType, stream->mBandRows);
+        #endif
+        if (stream->mOnHeader)
+            stream->mOnHeader(stream->mWidth, stream->mHeight);
+    }
+
+    static void row(png_structp png, png_bytep row, png_uint_32 rowIndex, int)
+    {
+        PngStream* stream = (PngStream*)png_get_progressive_ptr(png);
+        if (!row)
+            return;
+
+        int bandRow = (int)rowIndex % stream->mBandRows;
+        size_t rowBytes = (size_t)stream->mWidth * 4;
+        memcpy(&stream->mBand[bandRow * rowBytes], row, rowBytes);
+        if (bandRow == stream->mBandRows - 1 || (int)rowIndex == stream->mHeight - 1)
+        {
+            if (stream->mOnBand)
+                stream->mOnBand((int)rowIndex - bandRow, bandRow + 1, stream->mBand.data());
+        }
+    }
+
+    static void end(png_structp png, png_infop)
+    {
+        PngStream* stream = (PngStream*)png_get_progressive_ptr(png);
+        stream->mDone = true;
+    }
+};
+
+PngStream::PngStream(int bandRows, HeaderCallback onHeader, BandCallback onBand)
+    : mPng (nullptr)
+    , mInfo (nullptr)
+    , mBandRows (bandRows > 0 ? bandRows : 1)
+    , mOnHeader (onHeader)
+    , mOnBand (onBand)
+    , mWidth (0)
+    , mHeight (0)
+    , mFailed (false)
+    , mDone (false)
+{
+    mPng = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (mPng)
+        mInfo = png_create_info_struct(mPng);
+    if (!mPng || !mInfo)
+    {
+        printf("ERROR: Can't create PNG decoder\n");
+        mFailed = true;
+        return;
+    }
+    png_set_progressive_read_fn(mPng, this, PngStreamCallbacks::info, PngStreamCallbacks::row, PngStreamCallbacks::end);
+}
+
+PngStream::~PngStream()
+{
+    if (mPng)
+        png_destroy_read_struct(&mPng, mInfo ? &mInfo : nullptr, nullptr);
+}
+
+bool PngStream::feed(const unsigned char* data, size_t size)
+{
+    if (mFailed || mDone)
+        return !mFailed;
+
+    // libpng reports errors by longjmp back to here
+    if (setjmp(png_jmpbuf(mPng)))
+    {
+        mFailed = true;
+        return false;
+    }
+    png_process_data(mPng, mInfo, (png_bytep)data, size);
+    return true;
+}
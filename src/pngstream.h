@@ -0,0 +1,49 @@
+//
+// PNG stream - progressive PNG decoding with libpng, handing out RGBA rows a band at a time as the file's bytes
+// arrive, so large images can be uploaded while they decode, in bounded memory
+//
+// Build with -s USE_LIBPNG=1 in Emscripten, or link libpng (-lpng) natively.
+//
+#pragma once
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+class PngStream
+{
+public:
+    // Called once the header is read, with the image size
+    typedef std::function<void(int width, int height)> HeaderCallback;
+
+    // Called with each completed band of rows [row, row + rows), as tightly packed RGBA, valid during the call
+    typedef std::function<void(int row, int rows, const unsigned char* rgba)> BandCallback;
+
+    // Decode into bands of bandRows rows. Non-interlaced images only: interlaced ones revisit every row in
+    // 7 passes, so they can't be handed out in bands, and fail at the header.
+    PngStream(int bandRows, HeaderCallback onHeader, BandCallback onBand);
+    ~PngStream();
+
+    // Feed the file's next bytes, in chunks of any size, running the callbacks for whatever they complete.
+    // Returns false if the data isn't a supported PNG.
+    bool feed(const unsigned char* data, size_t size);
+
+    bool failed() const { return mFailed; }
+    bool done() const { return mDone; }
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+
+    // The band buffer's bytes, the most decoded pixels held at once
+    size_t bandBytes() const { return mBand.size(); }
+
+private:
+    friend struct PngStreamCallbacks;
+
+    struct png_struct_def* mPng;
+    struct png_info_def* mInfo;
+    int mBandRows;
+    HeaderCallback mOnHeader;
+    BandCallback mOnBand;
+    std::vector<unsigned char> mBand;
+    int mWidth, mHeight;
+    bool mFailed, mDone;
+};
@@ -0,0 +1,102 @@
+//
+// Signed distance fields - small glyph atlases that draw crisp text at any zoom, by thresholding the interpolated
+// distance to the glyph edge in the fragment shader instead of sampling coverage
+//
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "sdf.h"
+#include "threadpool.h"
+
+static const float cInfinity = 1e20f;
+
+// Felzenszwalb & Huttenlocher's 1D squared distance transform, d[q] = min over p of (q - p)^2 + f[p], from the lower
+// envelope of the parabolas rooted at each p. v and z are scratch of n and n + 1 entries.
+static void transform1D(const float* f, int n, float* d, int* v, float* z)
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -cInfinity;
+    z[1] = cInfinity;
+    for (int q = 1; q < n; ++q)
+    {
+        float s;
+        while (true)
+        {
+            int p = v[k];
+            s = ((f[q] + (float)q * q) - (f[p] + (float)p * p)) / (2.0f * (q - p));
+            if (s > z[k] || k == 0)
+                break;
+            k--;
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = cInfinity;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; ++q)
+    {
+        while (z[k + 1] < q)
+            k++;
+        float offset = (float)(q - v[k]);
+        d[q] = offset * offset + f[v[k]];
+    }
+}
+
+void buildDistanceField(const unsigned char* bitmap, int width, int height, int pitch, int scale, float spread,
+                        unsigned char* out, int outPitch)
+{
+    int outWidth = width / scale, outHeight = height / scale;
+    if (outWidth <= 0 || outHeight <= 0)
+        return;
+
+    // Squared distances to the nearest inside texel (for outside texels) and the nearest outside texel (for inside ones)
+    std::vector<float> toInside((size_t)width * height), toOutside((size_t)width * height);
+
+    // Rows, over the whole bitmap
+    ThreadPool::shared().parallelFor(0, height, 16, [&](int begin, int end)
+    {
+        std::vector<float> fIn(width), fOut(width), z(width + 1);
+        std::vector<int> v(width);
+        for (int y = begin; y < end; ++y)
+        {
+            const unsigned char* row = bitmap + (size_t)y * pitch;
+            for (int x = 0; x < width; ++x)
+            {
+                fIn[x] = row[x] ? 0.0f : cInfinity;
+                fOut[x] = row[x] ? cInfinity : 0.0f;
+            }
+            transform1D(fIn.data(), width, &toInside[(size_t)y * width], v.data(), z.data());
+            transform1D(fOut.data(), width, &toOutside[(size_t)y * width], v.data(), z.data());
+        }
+    });
+
+    // Columns, only those sampled by the downsampled field
+    ThreadPool::shared().parallelFor(0, outWidth, 8, [&](int begin, int end)
+    {
+        std::vector<float> fIn(height), fOut(height), dIn(height), dOut(height), z(height + 1);
+        std::vector<int> v(height);
+        for (int outX = begin; outX < end; ++outX)
+        {
+            int x = outX * scale + scale / 2;
+            for (int y = 0; y < height; ++y)
+            {
+                fIn[y] = toInside[(size_t)y * width + x];
+                fOut[y] = toOutside[(size_t)y * width + x];
+            }
+            transform1D(fIn.data(), height, dIn.data(), v.data(), z.data());
+            transform1D(fOut.data(), height, dOut.data(), v.data(), z.data());
+
+            for (int outY = 0; outY < outHeight; ++outY)
+            {
+                // Distances are between texel centers, so the edge is half a texel short of the nearest texel across it
+                int y = outY * scale + scale / 2;
+                float distance = bitmap[(size_t)y * pitch + x] ? 0.5f - sqrtf(dOut[y]) : sqrtf(dIn[y]) - 0.5f;
+                float value = 128.0f - 127.0f * distance / (scale * spread);
+                out[(size_t)outY * outPitch + outX] = (unsigned char)std::min(255.0f, std::max(0.0f, value + 0.5f));
+            }
+        }
+    });
+}
@@ -0,0 +1,13 @@
+//
+// Signed distance fields - small glyph atlases that draw crisp text at any zoom, by thresholding the interpolated
+// distance to the glyph edge in the fragment shader instead of sampling coverage
+//
+#pragma once
+
+// Build the distance field of a high resolution bitmap (nonzero texels are inside), downsampled by scale, with an
+// exact two pass (rows, then columns) Euclidean distance transform. out is (width / scale) x (height / scale) bytes,
+// rows outPitch apart: 128 on the edge, rising to 255 at spread output texels inside and falling to 0 at spread
+// texels outside. Pad the bitmap by spread * scale texels so the field falls off before its border.
+// Runs on the shared thread pool and doesn't use GL, so it can run on a worker or offline at atlas build time.
+void buildDistanceField(const unsigned char* bitmap, int width, int height, int pitch, int scale, float spread,
+                        unsigned char* out, int outPitch);
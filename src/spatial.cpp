@@ -0,0 +1,146 @@
+//
+// Spatial index - uniform grid over a world space extent, for culling and picking of many 2D items
+//
+#include <algorithm>
+#include <math.h>
+#include <SDL.h>
+#include <SDL_opengles2.h>
+#include "camera.h"
+#include "spatial.h"
+
+SpatialGrid::SpatialGrid(const WorldRect& extent, int expectedItems, int itemsPerCell)
+    : mExtent (extent)
+    , mCellsPerAxis (1)
+    , mQuery (0)
+    , mItemCount (0)
+{
+    // Square root of the cell count needed for the target density, rounded up to a power of 2.
+    // 1024 x 1024 cells at most, beyond that empty cells cost more memory than they save in queries.
+    const int maxCellsPerAxis = 1024;
+    int cellsPerAxis = (int)ceil(sqrt(std::max(1, expectedItems / std::max(1, itemsPerCell))));
+    while (mCellsPerAxis < cellsPerAxis && mCellsPerAxis < maxCellsPerAxis)
+        mCellsPerAxis *= 2;
+
+    mCellWidth = (extent.maxX - extent.minX) / mCellsPerAxis;
+    mCellHeight = (extent.maxY - extent.minY) / mCellsPerAxis;
+    mCells.resize(mCellsPerAxis * mCellsPerAxis);
+}
+
+// Interleave the bits of x and y, so cells near each other in 2D are near each other in memory
+unsigned int SpatialGrid::mortonIndex(unsigned int x, unsigned int y)
+{
+    auto spread = [](unsigned int v) 
+    {
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+// Cell coordinate of a world coordinate along one axis, clamped so items outside the extent land in edge cells
+int SpatialGrid::cellCoord(double world, double origin, double cellSize)
+{
+    double cell = cellSize > 0.0 ? (world - origin) / cellSize : 0.0;
+    return (int)std::max(0.0, std::min(cell, (double)(mCellsPerAxis - 1)));
+}
+
+SpatialGrid::CellRange SpatialGrid::cellRange(const WorldRect& bounds)
+{
+    return { cellCoord(bounds.minX, mExtent.minX, mCellWidth), cellCoord(bounds.minY, mExtent.minY, mCellHeight),
+             cellCoord(bounds.maxX, mExtent.minX, mCellWidth), cellCoord(bounds.maxY, mExtent.minY, mCellHeight) };
+}
+
+void SpatialGrid::insert(unsigned int id, const WorldRect& bounds)
+{
+    if (id >= mBounds.size())
+    {
+        mBounds.resize(id + 1);
+        mPresent.resize(id + 1, false);
+        mQueryStamp.resize(id + 1, 0);
+    }
+    if (mPresent[id])
+        remove(id);
+
+    mBounds[id] = bounds;
+    mPresent[id] = true;
+    mItemCount++;
+
+    CellRange range = cellRange(bounds);
+    for (int y = range.minY; y <= range.maxY; ++y)
+        for (int x = range.minX; x <= range.maxX; ++x)
+            mCells[mortonIndex(x, y)].push_back(id);
+}
+
+void SpatialGrid::remove(unsigned int id)
+{
+    if (id >= mBounds.size() || !mPresent[id])
+        return;
+
+    CellRange range = cellRange(mBounds[id]);
+    for (int y = range.minY; y <= range.maxY; ++y)
+        for (int x = range.minX; x <= range.maxX; ++x)
+        {
+            // Order within a cell doesn't matter, so swap with the last id and pop
+            std::vector<unsigned int>& cell = mCells[mortonIndex(x, y)];
+            auto found = std::find(cell.begin(), cell.end(), id);
+            if (found != cell.end())
+            {
+                *found = cell.back();
+                cell.pop_back();
+            }
+        }
+
+    mPresent[id] = false;
+    mItemCount--;
+}
+
+void SpatialGrid::clear()
+{
+    for (auto& cell : mCells)
+        cell.clear();
+    mBounds.clear();
+    mPresent.clear();
+    mQueryStamp.clear();
+    mItemCount = 0;
+}
+
+void SpatialGrid::queryRect(const WorldRect& rect, std::vector<unsigned int>& results)
+{
+    // New query stamp, resetting stamps on the rare wrap around
+    if (++mQuery == 0)
+    {
+        std::fill(mQueryStamp.begin(), mQueryStamp.end(), 0);
+        mQuery = 1;
+    }
+
+    CellRange range = cellRange(rect);
+    for (int y = range.minY; y <= range.maxY; ++y)
+        for (int x = range.minX; x <= range.maxX; ++x)
+            for (unsigned int id : mCells[mortonIndex(x, y)])
+            {
+                if (mQueryStamp[id] == mQuery)
+                    continue;
+                mQueryStamp[id] = mQuery;
+
+                const WorldRect& bounds = mBounds[id];
+                if (bounds.maxX >= rect.minX && bounds.minX <= rect.maxX
+                    && bounds.maxY >= rect.minY && bounds.minY <= rect.maxY)
+                    results.push_back(id);
+            }
+}
+
+void SpatialGrid::queryPoint(double x, double y, std::vector<unsigned int>& results)
+{
+    // Only one cell to search, so no duplicates to filter
+    int cellX = cellCoord(x, mExtent.minX, mCellWidth), 
+        cellY = cellCoord(y, mExtent.minY, mCellHeight);
+    for (unsigned int id : mCells[mortonIndex(cellX, cellY)])
+    {
+        const WorldRect& bounds = mBounds[id];
+        if (x >= bounds.minX && x <= bounds.maxX && y >= bounds.minY && y <= bounds.maxY)
+            results.push_back(id);
+    }
+}
@@ -0,0 +1,47 @@
+//
+// Spatial index - uniform grid over a world space extent, for culling and picking of many 2D items
+//
+// Requires camera.h (WorldRect) to be included first.
+//
+#pragma once
+#include <vector>
+
+class SpatialGrid
+{
+public:
+    // Cell resolution is chosen from the expected item density: about itemsPerCell items per cell, 
+    // with a power of 2 number of cells per axis so cells can be stored in Morton (Z-order) order
+    SpatialGrid(const WorldRect& extent, int expectedItems, int itemsPerCell = 8);
+
+    // Items are identified by caller assigned ids, ideally dense (e.g. indices into the caller's item array)
+    void insert(unsigned int id, const WorldRect& bounds);
+    void remove(unsigned int id);
+    void clear();
+
+    // Append ids of items whose bounds overlap rect, each id once (e.g. rect = Camera::visibleWorldRect())
+    void queryRect(const WorldRect& rect, std::vector<unsigned int>& results);
+
+    // Append ids of items whose bounds contain world point (x,y) (e.g. from Camera::windowToWorldCoords)
+    void queryPoint(double x, double y, std::vector<unsigned int>& results);
+
+    int size() { return mItemCount; }
+    int cellsPerAxis() { return mCellsPerAxis; }
+
+private:
+    struct CellRange { int minX, minY, maxX, maxY; };
+    CellRange cellRange(const WorldRect& bounds);
+    int cellCoord(double world, double origin, double cellSize);
+    static unsigned int mortonIndex(unsigned int x, unsigned int y);
+
+    WorldRect mExtent;
+    int mCellsPerAxis;
+    double mCellWidth, mCellHeight;
+    std::vector<std::vector<unsigned int>> mCells;
+
+    // Per id: bounds, whether present, and last query that returned it (to report items spanning cells once)
+    std::vector<WorldRect> mBounds;
+    std::vector<bool> mPresent;
+    std::vector<unsigned int> mQueryStamp;
+    unsigned int mQuery;
+    int mItemCount;
+};
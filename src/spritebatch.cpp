@@ -0,0 +1,273 @@
+//
+// Sprite batch - draws many textured, colored world space quads in as few draw calls as possible
+//
+#include <algorithm>
+#include <SDL.h>
+#include <SDL_opengles2.h>
+#include "camera.h"
+#include "spritebatch.h"
+
+// Vertex attribute indices
+const GLuint cornerAttrib = 0, rectAttrib = 1, uvRectAttrib = 2, instanceColorAttrib = 3;   // Instanced
+const GLuint positionAttrib = 0, texCoordAttrib = 1, colorAttrib = 2;                       // Expanded
+
+// Instanced sprite vertex shader: a unit quad corner per vertex, sprite rect, uv rect and color per instance
+const GLchar* instancedVertexSource =
+    "uniform float zoom;                                        \n"
+    "uniform float aspect;                                      \n"
+    "attribute vec2 corner;                                     \n"
+    "attribute vec4 rect;                                       \n"
+    "attribute vec4 uvRect;                                     \n"
+    "attribute vec4 color;                                      \n"
+    "varying vec2 vTexCoord;                                    \n"
+    "varying vec4 vColor;                                       \n"
+    "void main()                                                \n"
+    "{                                                          \n"
+    "    vec2 position = rect.xy + corner * rect.zw;            \n"
+    "    gl_Position = vec4(position * zoom, 0.0, 1.0);         \n"
+    "    gl_Position.y *= aspect;                               \n"
+    "    vTexCoord = mix(uvRect.xy, uvRect.zw, corner);         \n"
+    "    vColor = color;                                        \n"
+    "}                                                          \n";
+
+// Expanded sprite vertex shader: position, texture coord and color per vertex
+const GLchar* expandedVertexSource =
+    "uniform float zoom;                                        \n"
+    "uniform float aspect;                                      \n"
+    "attribute vec2 position;                                   \n"
+    "attribute vec2 texCoord;                                   \n"
+    "attribute vec4 color;                                      \n"
+    "varying vec2 vTexCoord;                                    \n"
+    "varying vec4 vColor;                                       \n"
+    "void main()                                                \n"
+    "{                                                          \n"
+    "    gl_Position = vec4(position * zoom, 0.0, 1.0);         \n"
+    "    gl_Position.y *= aspect;                               \n"
+    "    vTexCoord = texCoord;                                  \n"
+    "    vColor = color;                                        \n"
+    "}                                                          \n";
+
+// Per sprite instance data, and per vertex data for expanded quads
+struct SpriteInstance { GLfloat rect[4], uvRect[4]; GLubyte color[4]; };
+struct SpriteVertex { GLfloat position[2], texCoord[2]; GLubyte color[4]; };
+
+SpriteBatch::SpriteBatch()
+    : mInstanced (false)
+    , mStream (4 << 20)
+    , mDrawArraysInstanced (nullptr)
+    , mVertexAttribDivisor (nullptr)
+    , mPan ({0.0, 0.0}), mZoom (1.0f), mAspect (1.0f)
+    , mStats ({})
+{
+}
+
+void SpriteBatch::init()
+{
+    if (SDL_GL_ExtensionSupported("GL_ANGLE_instanced_arrays"))
+    {
+        mDrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDANGLEPROC)SDL_GL_GetProcAddress("glDrawArraysInstancedANGLE");
+        mVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORANGLEPROC)SDL_GL_GetProcAddress("glVertexAttribDivisorANGLE");
+        mInstanced = mDrawArraysInstanced && mVertexAttribDivisor;
+    }
+    printf("INFO: Sprite batch using %s\n", mInstanced ? "ANGLE_instanced_arrays" : "expanded quads");
+
+    if (mInstanced)
+    {
+        // Unit quad corners, drawn as a triangle strip per instance
+        GLfloat corners[] = { 0.0f, 0.0f,  1.0f, 0.0f,  0.0f, 1.0f,  1.0f, 1.0f };
+        mCornerVbo = GLBuffer::create();
+        mCornerVbo.data(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    }
+    else
+    {
+        // Two triangles per quad, shared by every batch
+        std::vector<GLushort> indices(cMaxBatchSprites * 6);
+        for (int i = 0; i < cMaxBatchSprites; ++i)
+        {
+            GLushort vertex = (GLushort)(i * 4);
+            GLushort quad[] = { vertex, (GLushort)(vertex + 1), (GLushort)(vertex + 2), 
+                                (GLushort)(vertex + 2), (GLushort)(vertex + 1), (GLushort)(vertex + 3) };
+            std::copy(quad, quad + 6, indices.begin() + i * 6);
+        }
+        mIndexVbo = GLBuffer::create();
+        mIndexVbo.data(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+    }
+}
+
+GLuint SpriteBatch::buildProgram(const GLchar* fragmentSource)
+{
+    const GLchar* vertexSource = mInstanced ? instancedVertexSource : expandedVertexSource;
+
+    // Create and compile vertex shader
+    GLShader vertexShader = GLShader::compile(GL_VERTEX_SHADER, vertexSource);
+
+    // Create and compile fragment shader
+    GLShader fragmentShader = GLShader::compile(GL_FRAGMENT_SHADER, fragmentSource);
+
+    // Link vertex and fragment shader into shader program.  The shaders are deleted on return, once linked.
+    GLProgram shaderProgram = GLProgram::create();
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    if (mInstanced)
+    {
+        glBindAttribLocation(shaderProgram, cornerAttrib, "corner");
+        glBindAttribLocation(shaderProgram, rectAttrib, "rect");
+        glBindAttribLocation(shaderProgram, uvRectAttrib, "uvRect");
+        glBindAttribLocation(shaderProgram, instanceColorAttrib, "color");
+    }
+    else
+    {
+        glBindAttribLocation(shaderProgram, positionAttrib, "position");
+        glBindAttribLocation(shaderProgram, texCoordAttrib, "texCoord");
+        glBindAttribLocation(shaderProgram, colorAttrib, "color");
+    }
+    glLinkProgram(shaderProgram);
+
+    // The batch owns its programs
+    mPrograms.push_back(std::move(shaderProgram));
+    return mPrograms.back();
+}
+
+void SpriteBatch::begin(Camera& camera)
+{
+    mSprites.clear();
+    mStats = {};
+    mStream.nextFrame();
+    mPan = camera.worldPan();
+    mZoom = camera.zoom();
+    mAspect = camera.aspect();
+}
+
+void SpriteBatch::end()
+{
+    // Sort by program, then texture, keeping submission order within each
+    mSorted.resize(mSprites.size());
+    for (size_t i = 0; i < mSprites.size(); ++i)
+        mSorted[i] = &mSprites[i];
+    std::stable_sort(mSorted.begin(), mSorted.end(), [](const Sprite* a, const Sprite* b)
+    {
+        return a->program != b->program ? a->program < b->program : a->texture < b->texture;
+    });
+
+    // Set up vertex layout, except for streamed attributes, which are pointed at each batch's upload in flush()
+    if (mInstanced)
+    {
+        for (GLuint attrib : { rectAttrib, uvRectAttrib, instanceColorAttrib })
+        {
+            glEnableVertexAttribArray(attrib);
+            mVertexAttribDivisor(attrib, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, mCornerVbo);
+        glVertexAttribPointer(cornerAttrib, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(cornerAttrib);
+    }
+    else
+    {
+        for (GLuint attrib : { positionAttrib, texCoordAttrib, colorAttrib })
+            glEnableVertexAttribArray(attrib);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexVbo);
+    }
+
+    // Submit runs of the same program and texture, in batches of at most cMaxBatchSprites
+    GLuint program = 0, texture = 0;
+    size_t runStart = 0;
+    for (size_t i = 0; i <= mSorted.size(); ++i)
+    {
+        bool runEnd = (i == mSorted.size()) 
+                      || mSorted[i]->program != mSorted[runStart]->program 
+                      || mSorted[i]->texture != mSorted[runStart]->texture
+                      || i - runStart == cMaxBatchSprites;
+        if (!runEnd || i == runStart)
+            continue;
+
+        const Sprite* first = mSorted[runStart];
+        if (first->program != program)
+        {
+            program = first->program;
+            glUseProgram(program);
+            glUniform1f(glGetUniformLocation(program, "zoom"), mZoom);
+            glUniform1f(glGetUniformLocation(program, "aspect"), mAspect);
+            mStats.stateChanges++;
+        }
+        if (first->texture != texture)
+        {
+            texture = first->texture;
+            glBindTexture(GL_TEXTURE_2D, texture);
+            mStats.stateChanges++;
+        }
+
+        flush(&mSorted[runStart], (int)(i - runStart));
+        runStart = i;
+    }
+
+    // Restore default vertex layout
+    if (mInstanced)
+    {
+        for (GLuint attrib : { rectAttrib, uvRectAttrib, instanceColorAttrib })
+        {
+            mVertexAttribDivisor(attrib, 0);
+            glDisableVertexAttribArray(attrib);
+        }
+        glDisableVertexAttribArray(cornerAttrib);
+    }
+    else
+    {
+        for (GLuint attrib : { positionAttrib, texCoordAttrib, colorAttrib })
+            glDisableVertexAttribArray(attrib);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Pack sprites into this frame's stream buffer, relative to the eye, and draw them with one call
+void SpriteBatch::flush(const Sprite* const* sprites, int count)
+{
+    if (mInstanced)
+    {
+        mStaging.resize(count * sizeof(SpriteInstance));
+        SpriteInstance* instances = (SpriteInstance*)mStaging.data();
+        for (int i = 0; i < count; ++i)
+        {
+            const Sprite& s = *sprites[i];
+            GLfloat x = (GLfloat)(s.x + mPan.x), y = (GLfloat)(s.y + mPan.y);
+            instances[i] = { { x, y, s.width, s.height }, { s.u0, s.v0, s.u1, s.v1 }, 
+                             { s.color[0], s.color[1], s.color[2], s.color[3] } };
+        }
+    }
+    else
+    {
+        mStaging.resize(count * 4 * sizeof(SpriteVertex));
+        SpriteVertex* vertices = (SpriteVertex*)mStaging.data();
+        for (int i = 0; i < count; ++i)
+        {
+            const Sprite& s = *sprites[i];
+            GLfloat x = (GLfloat)(s.x + mPan.x), y = (GLfloat)(s.y + mPan.y), x1 = x + s.width, y1 = y + s.height;
+            vertices[i * 4 + 0] = { { x, y }, { s.u0, s.v0 }, { s.color[0], s.color[1], s.color[2], s.color[3] } };
+            vertices[i * 4 + 1] = { { x1, y }, { s.u1, s.v0 }, { s.color[0], s.color[1], s.color[2], s.color[3] } };
+            vertices[i * 4 + 2] = { { x, y1 }, { s.u0, s.v1 }, { s.color[0], s.color[1], s.color[2], s.color[3] } };
+            vertices[i * 4 + 3] = { { x1, y1 }, { s.u1, s.v1 }, { s.color[0], s.color[1], s.color[2], s.color[3] } };
+        }
+    }
+
+    StreamBuffer::Allocation allocation = mStream.upload(mStaging.data(), mStaging.size());
+    const GLintptr base = allocation.offset;
+
+    if (mInstanced)
+    {
+        const GLsizei stride = sizeof(SpriteInstance);
+        glVertexAttribPointer(rectAttrib, 4, GL_FLOAT, GL_FALSE, stride, (const void*)(base + offsetof(SpriteInstance, rect)));
+        glVertexAttribPointer(uvRectAttrib, 4, GL_FLOAT, GL_FALSE, stride, (const void*)(base + offsetof(SpriteInstance, uvRect)));
+        glVertexAttribPointer(instanceColorAttrib, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const void*)(base + offsetof(SpriteInstance, color)));
+        mDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+    }
+    else
+    {
+        const GLsizei stride = sizeof(SpriteVertex);
+        glVertexAttribPointer(positionAttrib, 2, GL_FLOAT, GL_FALSE, stride, (const void*)(base + offsetof(SpriteVertex, position)));
+        glVertexAttribPointer(texCoordAttrib, 2, GL_FLOAT, GL_FALSE, stride, (const void*)(base + offsetof(SpriteVertex, texCoord)));
+        glVertexAttribPointer(colorAttrib, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const void*)(base + offsetof(SpriteVertex, color)));
+        glDrawElements(GL_TRIANGLES, count * 6, GL_UNSIGNED_SHORT, 0);
+    }
+
+    mStats.sprites += count;
+    mStats.drawCalls++;
+}
@@ -0,0 +1,59 @@
+//
+// Sprite batch - draws many textured, colored world space quads in as few draw calls as possible
+//
+// Requires camera.h to be included first.
+//
+#pragma once
+#include <vector>
+#include "streambuffer.h"
+
+struct Sprite
+{
+    GLfloat x, y, width, height;    // World space lower left corner and size
+    GLfloat u0, v0, u1, v1;         // Texture coords of lower left and upper right corners
+    GLubyte color[4];               // RGBA, multiplied with the texture
+    GLuint texture;
+    GLuint program;                 // From SpriteBatch::buildProgram()
+};
+
+class SpriteBatch
+{
+public:
+    SpriteBatch();
+
+    // Create GL buffers, using ANGLE_instanced_arrays if available, else 4 expanded vertices per sprite
+    void init();
+    bool instanced() { return mInstanced; }
+
+    // Build a sprite program from a fragment shader, which gets varyings vTexCoord and vColor. The batch owns it.
+    GLuint buildProgram(const GLchar* fragmentSource);
+
+    // Collect sprites, then sort them by program and texture and submit them in batches.
+    // Sprites of the same program and texture keep their order; sprites of different ones may be reordered.
+    void begin(Camera& camera);
+    void draw(const Sprite& sprite) { mSprites.push_back(sprite); }
+    void end();
+
+    struct Stats { unsigned int sprites, drawCalls, stateChanges; };
+    Stats& stats() { return mStats; }
+    StreamBuffer::Stats& streamStats() { return mStream.stats(); }
+
+private:
+    void flush(const Sprite* const* sprites, int count);
+
+    static const int cMaxBatchSprites = 16384; // Expanded quads use 16 bit indices, 4 vertices per sprite
+    bool mInstanced;
+    GLBuffer mCornerVbo, mIndexVbo;
+    std::vector<GLProgram> mPrograms;
+    StreamBuffer mStream;
+    PFNGLDRAWARRAYSINSTANCEDANGLEPROC mDrawArraysInstanced;
+    PFNGLVERTEXATTRIBDIVISORANGLEPROC mVertexAttribDivisor;
+
+    std::vector<Sprite> mSprites;
+    std::vector<const Sprite*> mSorted;
+    std::vector<GLubyte> mStaging;
+
+    Vec2d mPan; // Double precision, so sprites are rebased relative to the eye before they're made float
+    GLfloat mZoom, mAspect;
+    Stats mStats;
+};
@@ -0,0 +1,69 @@
+//
+// Stream buffer - ring of GL buffers for per-frame dynamic vertex data, without per-upload buffer reallocation
+//
+#include <algorithm>
+#include <SDL.h>
+#include <SDL_opengles2.h>
+#include "streambuffer.h"
+
+const int StreamBuffer::cMaxBuffers;
+
+StreamBuffer::StreamBuffer(GLsizeiptr bufferSize, int bufferCount, GLenum target)
+    : mTarget (target)
+    , mBufferSize (bufferSize)
+    , mBufferCount (std::max(1, std::min(bufferCount, cMaxBuffers)))
+    , mCurrent (0)
+    , mCapacity {}
+    , mOffset (0)
+    , mStats ({})
+    , mLastStats ({})
+{
+}
+
+void StreamBuffer::nextFrame()
+{
+    mLastStats = mStats;
+    mStats = {};
+    mCurrent = (mCurrent + 1) % mBufferCount;
+    mOffset = 0;
+}
+
+// Replace the current buffer's storage, so the GL can keep drawing from the old storage while we write the new one
+void StreamBuffer::orphan(GLsizeiptr size)
+{
+    mCapacity[mCurrent] = std::max(size, mCapacity[mCurrent]);
+    mBuffers[mCurrent].data(mTarget, mCapacity[mCurrent], nullptr, GL_STREAM_DRAW);
+    mOffset = 0;
+}
+
+StreamBuffer::Allocation StreamBuffer::upload(const void* data, GLsizeiptr size, GLsizeiptr alignment)
+{
+    // Buffers are created on first use, so a StreamBuffer can be constructed before the GL context
+    if (mBuffers[0] == 0)
+    {
+        for (int i = 0; i < mBufferCount; ++i)
+        {
+            mBuffers[i] = GLBuffer::create();
+            mBuffers[i].data(mTarget, mBufferSize, nullptr, GL_STREAM_DRAW);
+            mCapacity[i] = mBufferSize;
+        }
+    }
+
+    glBindBuffer(mTarget, mBuffers[mCurrent]);
+
+    GLintptr offset = (mOffset + alignment - 1) / alignment * alignment;
+    if (offset + size > mCapacity[mCurrent])
+    {
+        // Full (or too small for this upload, in which case it grows)
+        orphan(size);
+        offset = 0;
+        mStats.orphans++;
+    }
+
+    glBufferSubData(mTarget, offset, size, data);
+    mOffset = offset + size;
+
+    mStats.uploads++;
+    mStats.bytes += size;
+    return { mBuffers[mCurrent], offset };
+}
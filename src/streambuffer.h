@@ -0,0 +1,37 @@
+//
+// Stream buffer - ring of GL buffers for per-frame dynamic vertex data, without per-upload buffer reallocation
+//
+#pragma once
+#include "glresource.h"
+
+class StreamBuffer
+{
+public:
+    // bufferCount buffers of bufferSize bytes are used round robin, one per frame, so a buffer is only rewritten
+    // once the frames that drew from it (bufferCount - 1 frames ago) are no longer in flight
+    StreamBuffer(GLsizeiptr bufferSize = 1 << 20, int bufferCount = 3, GLenum target = GL_ARRAY_BUFFER);
+
+    // Start a new frame, moving on to the next buffer in the ring
+    void nextFrame();
+
+    // Copy data into this frame's buffer, returning the bound buffer and the byte offset of the data.
+    // If this frame's buffer is full, its storage is orphaned and allocation restarts at the beginning.
+    struct Allocation { GLuint buffer; GLintptr offset; };
+    Allocation upload(const void* data, GLsizeiptr size, GLsizeiptr alignment = 16);
+
+    // Bytes uploaded and orphaned buffers, for the previous frame
+    struct Stats { unsigned int uploads, orphans; size_t bytes; };
+    Stats& stats() { return mLastStats; }
+
+private:
+    void orphan(GLsizeiptr size);
+
+    GLenum mTarget;
+    GLsizeiptr mBufferSize;
+    static const int cMaxBuffers = 4;
+    int mBufferCount, mCurrent;
+    GLBuffer mBuffers[cMaxBuffers];
+    GLsizeiptr mCapacity[cMaxBuffers];
+    GLintptr mOffset;
+    Stats mStats, mLastStats;
+};
@@ -0,0 +1,398 @@
+//
+// Texture compression - encodes opaque images once to BC1 (DXT1) blocks, 4 bits per texel, as the intermediate
+// format, and transcodes them at load time to whatever the GPU samples: S3TC uploads the blocks as they are, ETC1
+// re-encodes each block, and anything else gets RGB565 texels
+//
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <SDL.h>
+#include <SDL_opengles2.h>
+#include "glresource.h"
+#include "texcompress.h"
+#include "threadpool.h"
+
+// #define TEXCOMPRESS_DEBUG
+
+static inline int clamp255(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+static inline unsigned short pack565(const int rgb[3])
+{
+    return (unsigned short)((((rgb[0] * 31 + 127) / 255) << 11) | (((rgb[1] * 63 + 127) / 255) << 5) |
+                            ((rgb[2] * 31 + 127) / 255));
+}
+
+static inline void unpack565(unsigned short color, int rgb[3])
+{
+    int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+static inline int distance2(const int a[3], const int b[3])
+{
+    int dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+    return dr * dr + dg * dg + db * db;
+}
+
+// Gather a block's 16 texels, row by row, as RGB, repeating the last row and column past the image's edges
+static void gatherBlock(const unsigned char* rgba, int width, int height, int blockX, int blockY, int texels[16][3])
+{
+    for (int y = 0; y < 4; ++y)
+    {
+        int row = std::min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; ++x)
+        {
+            const unsigned char* p = rgba + ((size_t)row * width + std::min(blockX * 4 + x, width - 1)) * 4;
+            texels[y * 4 + x][0] = p[0];
+            texels[y * 4 + x][1] = p[1];
+            texels[y * 4 + x][2] = p[2];
+        }
+    }
+}
+
+// BC1 palette: the endpoints and the two colors between them, or in 3 color mode (c0 <= c1) their midpoint and black
+static void bc1Palette(unsigned short c0, unsigned short c1, int palette[4][3])
+{
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c)
+    {
+        if (c0 > c1)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+}
+
+// Endpoints at the corners of the texels' bounding box, inset by 1/16 to cut the error of outliers, along the
+// diagonal that follows how red and blue vary with green; indices to the nearest palette color
+static void encodeBlock(const int texels[16][3], unsigned char* block)
+{
+    int minColor[3] = { 255, 255, 255 }, maxColor[3] = { 0, 0, 0 }, mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            minColor[c] = std::min(minColor[c], texels[i][c]);
+            maxColor[c] = std::max(maxColor[c], texels[i][c]);
+            mean[c] += texels[i][c];
+        }
+    }
+    int covarianceRG = 0, covarianceBG = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        int g = texels[i][1] * 16 - mean[1];
+        covarianceRG += (texels[i][0] * 16 - mean[0]) * g;
+        covarianceBG += (texels[i][2] * 16 - mean[2]) * g;
+    }
+    for (int c = 0; c < 3; ++c)
+    {
+        int inset = (maxColor[c] - minColor[c]) / 16;
+        minColor[c] += inset;
+        maxColor[c] -= inset;
+    }
+    if (covarianceRG < 0)
+        std::swap(minColor[0], maxColor[0]);
+    if (covarianceBG < 0)
+        std::swap(minColor[2], maxColor[2]);
+
+    // 4 color mode needs c0 > c1. Equal endpoints give a flat block, all index 0.
+    unsigned short c0 = pack565(maxColor), c1 = pack565(minColor);
+    if (c0 < c1)
+        std::swap(c0, c1);
+    int palette[4][3];
+    bc1Palette(c0, c1, palette);
+
+    unsigned int indices = 0;
+    if (c0 != c1)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            int best = 0, bestDistance = distance2(texels[i], palette[0]);
+            for (int p = 1; p < 4; ++p)
+            {
+                int d = distance2(texels[i], palette[p]);
+                if (d < bestDistance)
+                {
+                    best = p;
+                    bestDistance = d;
+                }
+            }
+            indices |= (unsigned int)best << (i * 2);
+        }
+    }
+
+    // Little endian
+    block[0] = (unsigned char)c0;
+    block[1] = (unsigned char)(c0 >> 8);
+    block[2] = (unsigned char)c1;
+    block[3] = (unsigned char)(c1 >> 8);
+    for (int i = 0; i < 4; ++i)
+        block[4 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+static void decodeBlock(const unsigned char* block, int texels[16][3])
+{
+    unsigned short c0 = (unsigned short)(block[0] | (block[1] << 8)), c1 = (unsigned short)(block[2] | (block[3] << 8));
+    int palette[4][3];
+    bc1Palette(c0, c1, palette);
+    for (int i = 0; i < 16; ++i)
+    {
+        int index = (block[4 + i / 4] >> ((i % 4) * 2)) & 3;
+        memcpy(texels[i], palette[index], sizeof(texels[i]));
+    }
+}
+
+void encodeBC1(const unsigned char* rgba, int width, int height, CompressedImage& image)
+{
+    int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+    image.width = width;
+    image.height = height;
+    image.blocks.resize((size_t)blocksWide * blocksHigh * 8);
+    ThreadPool::shared().parallelFor(0, blocksHigh, 4, [&](int rowBegin, int rowEnd)
+    {
+        int texels[16][3];
+        for (int blockY = rowBegin; blockY < rowEnd; ++blockY)
+        {
+            for (int blockX = 0; blockX < blocksWide; ++blockX)
+            {
+                gatherBlock(rgba, width, height, blockX, blockY, texels);
+                encodeBlock(texels, &image.blocks[((size_t)blockY * blocksWide + blockX) * 8]);
+            }
+        }
+    });
+}
+
+// ETC1 modifier tables, indexed by the 2 bit texel index (MSB, LSB)
+static const int etc1Modifiers[8][4] =
+{
+    { 2, 8, -2, -8 }, { 5, 17, -5, -17 }, { 9, 29, -9, -29 }, { 13, 42, -13, -42 },
+    { 18, 60, -18, -60 }, { 24, 80, -24, -80 }, { 33, 106, -33, -106 }, { 47, 183, -47, -183 },
+};
+
+// Best table and texel indices for a subblock of 8 texels around base. Returns the squared error.
+static int encodeETC1Subblock(const int texels[16][3], const int subblock[8], const int base[3], int& table,
+                              int indices[8])
+{
+    // A modifier moves all 3 channels together, so (clamping aside) the best is the one nearest the texel's mean
+    // offset from base
+    int offsets[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        const int* texel = texels[subblock[i]];
+        offsets[i] = texel[0] + texel[1] + texel[2] - base[0] - base[1] - base[2];
+    }
+
+    int bestError = 0x7fffffff;
+    for (int t = 0; t < 8; ++t)
+    {
+        int error = 0, tableIndices[8];
+        int threshold = (etc1Modifiers[t][0] + etc1Modifiers[t][1]) * 3 / 2;
+        for (int i = 0; i < 8 && error < bestError; ++i)
+        {
+            int offset = offsets[i];
+            int m = offset >= 0 ? (offset < threshold ? 0 : 1) : (-offset < threshold ? 2 : 3);
+            int modifier = etc1Modifiers[t][m];
+            int color[3] = { clamp255(base[0] + modifier), clamp255(base[1] + modifier), clamp255(base[2] + modifier) };
+            tableIndices[i] = m;
+            error += distance2(texels[subblock[i]], color);
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            table = t;
+            memcpy(indices, tableIndices, sizeof(tableIndices));
+        }
+    }
+    return bestError;
+}
+
+// An ETC1 block for 16 texels, row by row. Each half (2x4 or, flipped, 4x2) has a base color, the halves' average
+// colors, 5 bits with a 3 bit delta between them when they're close enough, or else 4 bits each. The split with
+// the least error is kept.
+static void encodeETC1Block(const int texels[16][3], unsigned char* block)
+{
+    int bestError = 0x7fffffff;
+    unsigned int bestHigh = 0, bestLow = 0;
+    for (int flip = 0; flip < 2; ++flip)
+    {
+        int subblocks[2][8], sums[2][3] = {};
+        int counts[2] = {};
+        for (int i = 0; i < 16; ++i)
+        {
+            int x = i % 4, y = i / 4;
+            int half = flip ? (y >= 2) : (x >= 2);
+            subblocks[half][counts[half]++] = i;
+            for (int c = 0; c < 3; ++c)
+                sums[half][c] += texels[i][c];
+        }
+
+        int quantized[2][3], bases[2][3];
+        bool differential = true;
+        for (int c = 0; c < 3; ++c)
+        {
+            for (int half = 0; half < 2; ++half)
+                quantized[half][c] = (sums[half][c] * 31 + 255 * 4) / (255 * 8);
+            int delta = quantized[1][c] - quantized[0][c];
+            differential = differential && delta >= -4 && delta <= 3;
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            for (int half = 0; half < 2; ++half)
+            {
+                if (!differential)
+                    quantized[half][c] = (sums[half][c] * 15 + 255 * 4) / (255 * 8);
+                int q = quantized[half][c];
+                bases[half][c] = differential ? (q << 3) | (q >> 2) : q * 17;
+            }
+        }
+
+        int tables[2], indices[2][8];
+        int error = encodeETC1Subblock(texels, subblocks[0], bases[0], tables[0], indices[0]) +
+                    encodeETC1Subblock(texels, subblocks[1], bases[1], tables[1], indices[1]);
+        if (error >= bestError)
+            continue;
+        bestError = error;
+
+        unsigned int high = 0;
+        for (int c = 0; c < 3; ++c)
+        {
+            int shift = 24 - c * 8;
+            if (differential)
+                high |= (quantized[0][c] << (shift + 3)) | (((quantized[1][c] - quantized[0][c]) & 7) << shift);
+            else
+                high |= (quantized[0][c] << (shift + 4)) | (quantized[1][c] << shift);
+        }
+        high |= (tables[0] << 5) | (tables[1] << 2) | ((differential ? 1 : 0) << 1) | flip;
+
+        // Texel indices are column by column, MSBs in the top half
+        unsigned int low = 0;
+        for (int half = 0; half < 2; ++half)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                int texel = subblocks[half][i];
+                int bit = (texel % 4) * 4 + texel / 4;
+                low |= ((indices[half][i] >> 1) << (16 + bit)) | ((indices[half][i] & 1) << bit);
+            }
+        }
+        bestHigh = high;
+        bestLow = low;
+    }
+
+    // Big endian
+    for (int i = 0; i < 4; ++i)
+    {
+        block[i] = (unsigned char)(bestHigh >> (24 - i * 8));
+        block[4 + i] = (unsigned char)(bestLow >> (24 - i * 8));
+    }
+}
+
+void transcodeBC1(const CompressedImage& image, CompressedFormat format, std::vector<unsigned char>& out)
+{
+    int width = image.width, height = image.height;
+    int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+    if (format == CompressedS3TC)
+    {
+        out = image.blocks;
+        return;
+    }
+
+    out.resize(compressedFormatBytes(format, width, height));
+    ThreadPool::shared().parallelFor(0, blocksHigh, 4, [&](int rowBegin, int rowEnd)
+    {
+        int texels[16][3];
+        for (int blockY = rowBegin; blockY < rowEnd; ++blockY)
+        {
+            for (int blockX = 0; blockX < blocksWide; ++blockX)
+            {
+                size_t block = (size_t)blockY * blocksWide + blockX;
+                decodeBlock(&image.blocks[block * 8], texels);
+                if (format == CompressedETC1)
+                {
+                    encodeETC1Block(texels, &out[block * 8]);
+                    continue;
+                }
+
+                // RGB565 texels, in native byte order for GL_UNSIGNED_SHORT_5_6_5, clipped to the image
+                for (int y = 0; y < 4 && blockY * 4 + y < height; ++y)
+                {
+                    unsigned short* row = (unsigned short*)&out[((size_t)(blockY * 4 + y) * width + blockX * 4) * 2];
+                    for (int x = 0; x < 4 && blockX * 4 + x < width; ++x)
+                        row[x] = pack565(texels[y * 4 + x]);
+                }
+            }
+        }
+    });
+}
+
+bool compressedFormatSupported(CompressedFormat format)
+{
+    switch (format)
+    {
+        case CompressedS3TC:
+            return SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc") ||
+                   SDL_GL_ExtensionSupported("GL_EXT_texture_compression_dxt1") ||
+                   SDL_GL_ExtensionSupported("GL_WEBGL_compressed_texture_s3tc");
+        case CompressedETC1:
+            return SDL_GL_ExtensionSupported("GL_OES_compressed_ETC1_RGB8_texture") ||
+                   SDL_GL_ExtensionSupported("GL_WEBGL_compressed_texture_etc1");
+        case CompressedRGB565:
+            return true;
+        default:
+            return false;
+    }
+}
+
+CompressedFormat selectCompressedFormat()
+{
+    int format = 0;
+    while (!compressedFormatSupported((CompressedFormat)format))
+        ++format;
+    #ifdef TEXCOMPRESS_DEBUG
+        printf("compressed formats: S3TC %d, ETC1 %d\n", compressedFormatSupported(CompressedS3TC),
+               compressedFormatSupported(CompressedETC1));
+    #endif
+    return (CompressedFormat)format;
+}
+
+const char* compressedFormatName(CompressedFormat format)
+{
+    static const char* names[] = { "S3TC DXT1", "ETC1", "RGB565" };
+    return format >= 0 && format < CompressedFormatCount ? names[format] : "unknown";
+}
+
+size_t compressedFormatBytes(CompressedFormat format, int width, int height)
+{
+    if (format == CompressedRGB565)
+        return (size_t)width * height * 2;
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+}
+
+void uploadCompressed(GLTexture& texture, GLint level, CompressedFormat format, int width, int height,
+                      const std::vector<unsigned char>& data)
+{
+    if (format == CompressedRGB565)
+    {
+        // Rows of 2 byte texels are only 4 byte aligned for even widths
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        texture.image2D(level, GL_RGB, width, height, GL_UNSIGNED_SHORT_5_6_5, data.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    else
+    {
+        GLenum internalFormat = format == CompressedS3TC ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_ETC1_RGB8_OES;
+        texture.compressedImage2D(level, internalFormat, width, height, (GLsizei)data.size(), data.data());
+    }
+}
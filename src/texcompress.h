@@ -0,0 +1,36 @@
+//
+// Texture compression - encodes opaque images once to BC1 (DXT1) blocks, 4 bits per texel, as the intermediate
+// format, and transcodes them at load time to whatever the GPU samples: S3TC uploads the blocks as they are, ETC1
+// re-encodes each block, and anything else gets RGB565 texels
+//
+// Requires SDL_opengles2.h and glresource.h to be included first.
+//
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+// Upload formats, best first
+enum CompressedFormat { CompressedS3TC, CompressedETC1, CompressedRGB565, CompressedFormatCount };
+
+// width x height texels as 8 byte blocks of 4x4 texels, in rows of blocks, edge blocks padded
+struct CompressedImage { int width, height; std::vector<unsigned char> blocks; };
+
+// Encode tightly packed RGBA rows to BC1, ignoring alpha. Edge blocks repeat the image's last row and column. Rows
+// of blocks are encoded in parallel on the shared thread pool. Doesn't use GL, so it can run on a worker, or offline.
+void encodeBC1(const unsigned char* rgba, int width, int height, CompressedImage& image);
+
+// Transcode to format's upload data: the BC1 blocks themselves for S3TC, 8 byte ETC1 blocks, or 2 byte RGB565 texels.
+// Doesn't use GL.
+void transcodeBC1(const CompressedImage& image, CompressedFormat format, std::vector<unsigned char>& out);
+
+// Whether the current GL context can sample format, from its extensions, and the best format it can
+bool compressedFormatSupported(CompressedFormat format);
+CompressedFormat selectCompressedFormat();
+const char* compressedFormatName(CompressedFormat format);
+
+// Bytes of format's upload data for width x height texels
+size_t compressedFormatBytes(CompressedFormat format, int width, int height);
+
+// Upload transcoded data as a level of texture
+void uploadCompressed(GLTexture& texture, GLint level, CompressedFormat format, int width, int height,
+                      const std::vector<unsigned char>& data);
@@ -5,15 +5,29 @@
 // https://web.archive.org/web/20010616211947/http://reality.sgi.com/opengl/tips/TexFont/TexFont.html
 //
 
+#include <algorithm>
 #include <assert.h>
 #include <ctype.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <SDL.h>
 #include "texfont.h"
+#include "threadpool.h"
+#include "arena.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define TXF_SIMD 1
+#endif
 
 //#define TXF_DEBUG 1
 
+// Glyph runs: 6 vertices of 5 floats per glyph, built in chunks of this many glyphs when parallel
+const int cGlyphFloats = 6 * 5;
+const int cGlyphRunChunk = 8192;
+
 // byte swap a 32-bit value 
 inline void byteSwap32Bit(int* val)
 {
@@ -44,7 +58,7 @@ txfErrorString(void)
 }
 
 static TexGlyphVertexInfo *
-getTCVI(TexFont * txf, int c)
+findTCVI(TexFont * txf, int c)
 {
     // Automatically substitute uppercase letters with lowercase if not
     // uppercase available (and vice versa). 
@@ -71,10 +85,45 @@ getTCVI(TexFont * txf, int c)
             }
         }
     }
-    printf("texfont: tried to access unavailable font character \"%c\" (%d)\n", isprint(c) ? c : ' ', c);
     return NULL;
 }
 
+static void
+printUnavailable(int c)
+{
+    printf("texfont: tried to access unavailable font character \"%c\" (%d)\n", isprint(c) ? c : ' ', c);
+}
+
+static TexGlyphVertexInfo *
+getTCVI(TexFont * txf, int c)
+{
+    TexGlyphVertexInfo *tgvi = findTCVI(txf, c);
+    if (!tgvi)
+        printUnavailable(c);
+    return tgvi;
+}
+
+// Glyph table for building runs, with each quad's tristrip vertices expanded to two triangles
+static void
+buildGlyphTable(TexFont * txf)
+{
+    static const int triangleVertices[6] = {0, 1, 2, 1, 2, 3};
+
+    TexGlyphTable *table = new TexGlyphTable();
+    for (int c = 0; c < 256; ++c)
+    {
+        TexGlyphVertexInfo *tgvi = findTCVI(txf, c);
+        if (tgvi)
+        {
+            for (int v = 0; v < 6; ++v)
+                memcpy(&table->quads[c][v * 5], &tgvi->vertexArray[triangleVertices[v] * 5], 5 * sizeof(GLfloat));
+            table->advances[c] = tgvi->advance;
+            table->present[c] = 1;
+        }
+    }
+    txf->glyphTable = table;
+}
+
 void txfLoadFontError(const char* errorStr, TexFont *txf, FILE* file)
 {
     lastError = (char*)errorStr;
@@ -104,6 +153,10 @@ txfLoadFont(const char *filename)
     txf->tgi = NULL;
     txf->tgvi = NULL;
     txf->lut = NULL;
+    txf->glyphTable = NULL;
+    txf->gpuLayout = false;
+    txf->drawArraysInstanced = NULL;
+    txf->vertexAttribDivisor = NULL;
 
     char fileid[4];
     unsigned long got = fread(fileid, 1, 4, file);
@@ -264,6 +317,7 @@ txfLoadFont(const char *filename)
         txf->lut[i] = NULL;
     for (int i = 0; i < txf->num_glyphs; i++) 
         txf->lut[txf->tgi[i].c - txf->min_glyph] = &txf->tgvi[i];
+    buildGlyphTable(txf);
 
     switch (format) 
     {
@@ -301,16 +355,21 @@ txfLoadFont(const char *filename)
                 if (txf->teximage == NULL)
                     TXF_LOAD_ERROR("out of memory.");
                 
-                for (int i = 0; i < height; i++) 
+                // Expand rows in parallel
+                unsigned char *teximage = txf->teximage;
+                ThreadPool::shared().parallelFor(0, height, 16, [=](int rowBegin, int rowEnd)
                 {
-                    for (int j = 0; j < width; j++) 
+                    for (int i = rowBegin; i < rowEnd; i++) 
                     {
-                        if (texbitmap[i * stride + (j >> 3)] & (1 << (j & 7))) 
-                            txf->teximage[i * width + j] = 255;
-                        else
-                            txf->teximage[i * width + j] = 0;
+                        for (int j = 0; j < width; j++) 
+                        {
+                            if (texbitmap[i * stride + (j >> 3)] & (1 << (j & 7))) 
+                                teximage[i * width + j] = 255;
+                            else
+                                teximage[i * width + j] = 0;
+                        }
                     }
-                }
+                });
                 
                 delete[] texbitmap;
 
@@ -334,20 +393,39 @@ txfEstablishTexture(TexFont * txf, GLuint texobj)
     if (txf->texobj == 0) 
     {
         if (texobj == 0)
-            glGenTextures(1, &txf->texobj);
+            txf->texobj = GLTexture::create();
         else
-            txf->texobj = texobj;
+            txf->texobj = GLTexture::adopt(texobj);
     }
  
-    glBindTexture(GL_TEXTURE_2D, txf->texobj);
     const GLenum format = GL_ALPHA; // r,g,b = 0,0,0; a = teximage
-    glTexImage2D(GL_TEXTURE_2D, 0, format,
-        txf->tex_width, txf->tex_height, 0,
-        format, GL_UNSIGNED_BYTE, txf->teximage);
+    txf->texobj.image2D(0, format, txf->tex_width, txf->tex_height, GL_UNSIGNED_BYTE, txf->teximage);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Mip level rows are tightly packed, and narrower than 4 bytes near 1x1
+    for (size_t i = 0; i < txf->mipLevels.size(); ++i)
+    {
+        const MipLevel& level = txf->mipLevels[i];
+        txf->texobj.image2D((GLint)i + 1, format, level.width, level.height, GL_UNSIGNED_BYTE, level.pixels.data());
+    }
 
     return txf->texobj;
 }
 
+bool
+txfBuildMipmaps(TexFont * txf, MipStats *stats)
+{
+    if ((txf->tex_width & (txf->tex_width - 1)) || (txf->tex_height & (txf->tex_height - 1)))
+        return false;
+
+    std::vector<MipRect> rects;
+    for (int i = 0; i < txf->num_glyphs; ++i)
+    {
+        const TexGlyphInfo& tgi = txf->tgi[i];
+        rects.push_back({ tgi.x, tgi.y, tgi.width, tgi.height });
+    }
+    txf->mipLevels = buildAtlasMipmaps(txf->teximage, txf->tex_width, txf->tex_height, txf->tex_width, 1, rects, stats);
+    return true;
+}
+
 void
 txfBindFontTexture(TexFont * txf)
 {
@@ -389,6 +467,90 @@ txfGetStringMetrics(
     *max_descent = txf->max_descent;
 }
 
+// Emit glyphs [begin,end) of a run, starting at pen x, and return the pen x after them.
+// Each glyph is its table quad, with pen added to the x of its 6 vertices.
+static GLfloat
+emitGlyphs(const TexGlyphTable * table, const unsigned char *glyphs, int begin, int end, GLfloat pen, GLfloat *vertices)
+{
+    GLfloat *out = vertices + begin * cGlyphFloats;
+
+#ifdef TXF_SIMD
+    // x is at floats 0,5,10,15,20,25: lane 0 of vectors 0 and 5, lane 1 of 1 and 6, lane 2 of 2, lane 3 of 3
+    const __m128 lane0 = _mm_castsi128_ps(_mm_set_epi32(0, 0, 0, -1)),
+                 lane1 = _mm_castsi128_ps(_mm_set_epi32(0, 0, -1, 0)),
+                 lane2 = _mm_castsi128_ps(_mm_set_epi32(0, -1, 0, 0)),
+                 lane3 = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+    for (int i = begin; i < end; ++i, out += cGlyphFloats)
+    {
+        const unsigned char g = glyphs[i];
+        const GLfloat *quad = table->quads[g];
+        const __m128 penv = _mm_set1_ps(pen),
+                     pen0 = _mm_and_ps(penv, lane0), pen1 = _mm_and_ps(penv, lane1);
+
+        _mm_storeu_ps(out + 0, _mm_add_ps(_mm_loadu_ps(quad + 0), pen0));
+        _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(quad + 4), pen1));
+        _mm_storeu_ps(out + 8, _mm_add_ps(_mm_loadu_ps(quad + 8), _mm_and_ps(penv, lane2)));
+        _mm_storeu_ps(out + 12, _mm_add_ps(_mm_loadu_ps(quad + 12), _mm_and_ps(penv, lane3)));
+        _mm_storeu_ps(out + 16, _mm_loadu_ps(quad + 16));
+        _mm_storeu_ps(out + 20, _mm_add_ps(_mm_loadu_ps(quad + 20), pen0));
+        _mm_storeu_ps(out + 24, _mm_add_ps(_mm_loadu_ps(quad + 24), pen1));
+        _mm_storel_pi((__m64*)(out + 28), _mm_loadu_ps(quad + 28));
+
+        pen += table->advances[g];
+    }
+#else
+    for (int i = begin; i < end; ++i, out += cGlyphFloats)
+    {
+        const unsigned char g = glyphs[i];
+        memcpy(out, table->quads[g], cGlyphFloats * sizeof(GLfloat));
+        for (int v = 0; v < 6; ++v)
+            out[v * 5] += pen;
+
+        pen += table->advances[g];
+    }
+#endif
+
+    return pen;
+}
+
+GLfloat
+txfBuildGlyphRun(TexFont * txf, const char *str, int len, GLfloat *vertices, bool parallel)
+{
+    const TexGlyphTable *table = txf->glyphTable;
+    const unsigned char *glyphs = (const unsigned char *)str;
+    ThreadPool& pool = ThreadPool::shared();
+
+    const int chunks = (len + cGlyphRunChunk - 1) / cGlyphRunChunk;
+    if (!parallel || chunks < 2 || pool.threadCount() < 2)
+        return emitGlyphs(table, glyphs, 0, len, 0.0f, vertices);
+
+    // Each chunk starts at the sum of the advances before it, an exclusive prefix sum over the chunks'
+    // advance sums, so chunks can be emitted independently
+    ScratchScope scratch;
+    GLfloat *chunkPens = scratch.allocate<GLfloat>(chunks + 1);
+    chunkPens[0] = 0.0f;
+    pool.parallelFor(0, chunks, 1, [=](int chunkBegin, int chunkEnd)
+    {
+        for (int chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+        {
+            GLfloat sum = 0.0f;
+            for (int i = chunk * cGlyphRunChunk, end = std::min(len, i + cGlyphRunChunk); i < end; ++i)
+                sum += table->advances[glyphs[i]];
+            chunkPens[chunk + 1] = sum;
+        }
+    });
+    for (int chunk = 0; chunk < chunks; ++chunk)
+        chunkPens[chunk + 1] += chunkPens[chunk];
+
+    pool.parallelFor(0, chunks, 1, [=](int chunkBegin, int chunkEnd)
+    {
+        for (int chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+            emitGlyphs(table, glyphs, chunk * cGlyphRunChunk, std::min(len, (chunk + 1) * cGlyphRunChunk), chunkPens[chunk], vertices);
+    });
+    return chunkPens[chunks];
+}
+
 void
 txfRenderString(TexFont * txf, const char *str, float x, float y)
 {
@@ -400,81 +562,44 @@ txfRenderString(TexFont * txf, const char *str, float x, float y)
                     vertexFloats = vertexPositionFloats + vertexTexCoordFloats, // x,y,z + u,v = 5
                     vertexBytes = vertexFloats * sizeof(GLfloat),
                     quadVertices = 6, // two independent triangles = 6 vertices
-                    quadFloats = vertexFloats * quadVertices, // 5 * 6 = 30 floats
                     vertexArrayVertices = quadVertices * numChars, // 6 * numchars
                     vertexArrayFloats = vertexFloats * vertexArrayVertices, // 5 * 6 * numchars
                     vertexArrayBytes = vertexBytes * vertexArrayVertices;
 
         GLuint quadsVboId = 0;
 
-        auto stringVBO = txf->stringVBOs.find(str);
+        // Look up with a reused key string, so finding a cached string doesn't allocate
+        txf->stringKey.assign(str);
+        auto stringVBO = txf->stringVBOs.find(txf->stringKey);
         if (stringVBO == txf->stringVBOs.end())
         {
-            // Not found - build VBO and add to map
-            GLfloat* stringVertexArray = new GLfloat[vertexArrayFloats];
-
-            // Start advance at caller specified x
-            GLfloat advance = x;
+            // Not found - build VBO in scratch memory and add to map. The string is built at the origin and
+            // positioned when drawn, so one VBO serves every placement of the same string.
+            ScratchScope scratch;
+            GLfloat* stringVertexArray = scratch.allocate<GLfloat>(vertexArrayFloats);
 
             for (int i = 0; i < numChars; ++i)
-            {
-                char c = str[i];
-                int quadIndex = i * quadFloats;
+                if (!txf->glyphTable->present[(unsigned char)str[i]])
+                    printUnavailable((unsigned char)str[i]);
+            txfBuildGlyphRun(txf, str, (int)numChars, stringVertexArray);
 
-                TexGlyphVertexInfo *tgvi = getTCVI(txf, c);
-                if (tgvi)
+            #ifdef TXF_DEBUG
+                for (int i = 0; i < vertexArrayVertices; ++i)
                 {
-                    // Copy char's vertexArray into stringVertexArray
-                    // Triangle #1
-                    for (int j = 0; j < 3; ++j) // vertices
-                        for (int k = 0; k < 5; ++k) // floats x,y,z,u,v
-                            stringVertexArray[i * 5 * 6 + j * 5 + k] = tgvi->vertexArray[j * 5 + k];
-
-                    // Triangle #2
-                    for (int j = 3; j < 6; ++j) // vertices
-                        for (int k = 0; k < 5; ++k) // floats x,y,z,u,v
-                            stringVertexArray[i * 5 * 6 + j * 5 + k] = tgvi->vertexArray[(j - 2) * 5 + k];
-
-
-                    // Translate x positions by accumulated advance
-                    // Translate y positions by caller specified y
-                    for (int j = 0; j < 6; ++j)
-                    {
-                        stringVertexArray[i * 5 * 6 + j * 5] += advance;
-                        stringVertexArray[i * 5 * 6 + j * 5 + 1] += y;
-                    }
-
-                    advance += tgvi->advance;
-
-                    #ifdef TXF_DEBUG
-                        for (int i = 0; i < 4; ++i)
-                        {
-                            GLfloat* va = tgvi->vertexArray;
-                            printf("tgvi va pos[%d] (%f,%f,%f) tex[%d] (%f,%f)\n",
-                                    i, va[i*5], va[i*5+1], va[i*5+2],
-                                    i, va[i*5+3], va[i*5+4]);
-                        }
-                        printf ("tgvi advance %f\n", tgvi->advance);
-
-                        for (int i = 0; i < numVertices; ++i)
-                        {
-                            GLfloat* va = stringVertexArray;
-                            printf("strva pos[%d] (%f,%f,%f) tex[%d] (%f,%f)\n",
-                                    i, va[i*5], va[i*5+1], va[i*5+2],
-                                    i, va[i*5+3], va[i*5+4]);
-                        }
-                    #endif
+                    GLfloat* va = stringVertexArray;
+                    printf("strva pos[%d] (%f,%f,%f) tex[%d] (%f,%f)\n",
+                            i, va[i*5], va[i*5+1], va[i*5+2],
+                            i, va[i*5+3], va[i*5+4]);
                 }
-            }
+            #endif
 
             // Build VBO
-            glGenBuffers(1, &quadsVboId);
-            glBindBuffer(GL_ARRAY_BUFFER, quadsVboId);
-            glBufferData(GL_ARRAY_BUFFER, 5 * 6 * numChars * sizeof(GLfloat), stringVertexArray, GL_STATIC_DRAW);
-            delete[] stringVertexArray;
+            GLBuffer quadsVbo = GLBuffer::create();
+            quadsVbo.data(GL_ARRAY_BUFFER, vertexArrayBytes, stringVertexArray, GL_STATIC_DRAW);
+            quadsVboId = quadsVbo;
 
             // Cache the string/VBO pair
-            txf->stringVBOs.insert({str, quadsVboId});
+            txf->stringVBOs.emplace(txf->stringKey, std::move(quadsVbo));
         }
         else 
         {
@@ -483,11 +608,14 @@ txfRenderString(TexFont * txf, const char *str, float x, float y)
             glBindBuffer(GL_ARRAY_BUFFER, quadsVboId);
         }
 
-        // Draw the string VBO
+        // Draw the string VBO, offset to the caller's position by a constant vertex attribute
         if (quadsVboId != 0)
         {
             const GLuint vertexPositionIndex = 0, 
-                         vertexTexCoordIndex = 1;            
+                         vertexTexCoordIndex = 1,
+                         vertexOffsetIndex = 2;
+            glVertexAttrib2f(vertexOffsetIndex, x, y);
+
             GLuint offset = 0;
             glVertexAttribPointer(vertexPositionIndex, vertexPositionFloats, GL_FLOAT, GL_FALSE, vertexFloats * sizeof(GLfloat), (const void*)offset);
             offset += vertexPositionFloats * sizeof(GLfloat);
@@ -498,21 +626,180 @@ txfRenderString(TexFont * txf, const char *str, float x, float y)
     }
 }
 
+bool
+txfInitGpuLayout(TexFont * txf)
+{
+    GLint vertexTextureUnits = 0;
+    glGetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &vertexTextureUnits);
+    if (vertexTextureUnits > 0 && SDL_GL_ExtensionSupported("GL_ANGLE_instanced_arrays"))
+    {
+        txf->drawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDANGLEPROC)SDL_GL_GetProcAddress("glDrawArraysInstancedANGLE");
+        txf->vertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORANGLEPROC)SDL_GL_GetProcAddress("glVertexAttribDivisorANGLE");
+    }
+    txf->gpuLayout = txf->drawArraysInstanced && txf->vertexAttribDivisor;
+    printf("INFO: TexFont dynamic text laid out %s\n", txf->gpuLayout ? "on the GPU" : "as CPU quads, no vertex textures or instancing");
+    if (!txf->gpuLayout)
+        return false;
+
+    // Texel 2g is glyph g's quad offset + 128 and size, texel 2g+1 its atlas x,y as low and high bytes
+    const int metricsWidth = 512;
+    GLubyte metrics[metricsWidth * 4] = {};
+    for (int c = 0; c < 256; ++c)
+    {
+        TexGlyphVertexInfo *tgvi = findTCVI(txf, c);
+        if (tgvi)
+        {
+            const TexGlyphInfo& tgi = txf->tgi[tgvi - txf->tgvi];
+            GLubyte *texels = &metrics[c * 2 * 4];
+            texels[0] = (GLubyte)(tgi.xoffset + 128);
+            texels[1] = (GLubyte)(tgi.yoffset + 128);
+            texels[2] = tgi.width;
+            texels[3] = tgi.height;
+            texels[4] = (GLubyte)(tgi.x & 0xff);
+            texels[5] = (GLubyte)((tgi.x >> 8) & 0xff);
+            texels[6] = (GLubyte)(tgi.y & 0xff);
+            texels[7] = (GLubyte)((tgi.y >> 8) & 0xff);
+        }
+    }
+    txf->metricsTexture = GLTexture::create();
+    glBindTexture(GL_TEXTURE_2D, txf->metricsTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    txf->metricsTexture.image2D(0, GL_RGBA, metricsWidth, 1, GL_UNSIGNED_BYTE, metrics);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Unit quad corners, drawn as a triangle strip per glyph instance
+    GLfloat corners[] = { 0.0f, 0.0f,  1.0f, 0.0f,  0.0f, 1.0f,  1.0f, 1.0f };
+    txf->cornerVbo = GLBuffer::create();
+    txf->cornerVbo.data(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    return true;
+}
+
+int
+txfLayoutText(TexFont * txf, const char *text, float x, float y, TexGlyphInstance *instances)
+{
+    const TexGlyphTable *table = txf->glyphTable;
+    const GLfloat lineHeight = (GLfloat)(txf->max_ascent + txf->max_descent);
+
+    GLfloat penX = x, penY = y;
+    int count = 0;
+    for (const unsigned char *c = (const unsigned char *)text; *c; ++c)
+    {
+        if (*c == '\n')
+        {
+            penX = x;
+            penY -= lineHeight;
+            continue;
+        }
+        if (table->present[*c])
+        {
+            TexGlyphInstance& instance = instances[count++];
+            instance.pen[0] = penX;
+            instance.pen[1] = penY;
+            instance.glyph = *c;
+        }
+        penX += table->advances[*c];
+    }
+    return count;
+}
+
 void
-txfUnloadFont(TexFont * txf)
+txfBeginFrame(TexFont * txf)
 {
     if (txf)
-    {
-        if (txf->texobj != 0)
-            glDeleteTextures(1, &txf->texobj);
+        txf->textStream.nextFrame();
+}
 
-        for (auto stringVBO = txf->stringVBOs.begin(); stringVBO != txf->stringVBOs.end(); ++stringVBO)
-            glDeleteBuffers(1, &stringVBO->second);
+void
+txfRenderText(TexFont * txf, const char *text, float x, float y)
+{
+    size_t len = txf ? strlen(text) : 0;
+    if (len == 0)
+        return;
 
+    ScratchScope scratch;
+    if (txf->gpuLayout)
+    {
+        // Upload 12 bytes per glyph; the vertex shader builds its quad from the metrics texture
+        const GLuint cornerIndex = 0, penIndex = 1, glyphIndex = 2;
+        TexGlyphInstance *instances = scratch.allocate<TexGlyphInstance>(len);
+        int count = txfLayoutText(txf, text, x, y, instances);
+        if (count == 0)
+            return;
+
+        StreamBuffer::Allocation allocation = txf->textStream.upload(instances, count * sizeof(TexGlyphInstance));
+        const GLsizei stride = sizeof(TexGlyphInstance);
+        glVertexAttribPointer(penIndex, 2, GL_FLOAT, GL_FALSE, stride, (const void*)(allocation.offset + offsetof(TexGlyphInstance, pen)));
+        glVertexAttribPointer(glyphIndex, 1, GL_UNSIGNED_BYTE, GL_FALSE, stride, (const void*)(allocation.offset + offsetof(TexGlyphInstance, glyph)));
+        glBindBuffer(GL_ARRAY_BUFFER, txf->cornerVbo);
+        glVertexAttribPointer(cornerIndex, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, txf->metricsTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        for (GLuint index : { penIndex, glyphIndex })
+        {
+            glEnableVertexAttribArray(index);
+            txf->vertexAttribDivisor(index, 1);
+        }
+        txf->drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+        for (GLuint index : { penIndex, glyphIndex })
+        {
+            txf->vertexAttribDivisor(index, 0);
+            glDisableVertexAttribArray(index);
+        }
+    }
+    else
+    {
+        // Build each line's glyph run below the last, and stream the quads rather than caching them
+        const GLuint vertexPositionIndex = 0, vertexTexCoordIndex = 1, vertexOffsetIndex = 2;
+        const GLfloat lineHeight = (GLfloat)(txf->max_ascent + txf->max_descent);
+        GLfloat *vertices = scratch.allocate<GLfloat>(len * cGlyphFloats);
+        int glyphs = 0;
+        GLfloat lineY = 0.0f;
+        for (const char *line = text; ; line++)
+        {
+            const char *lineEnd = strchr(line, '\n');
+            int lineLen = lineEnd ? (int)(lineEnd - line) : (int)strlen(line);
+            GLfloat *lineVertices = vertices + glyphs * cGlyphFloats;
+            txfBuildGlyphRun(txf, line, lineLen, lineVertices, false);
+            for (int v = 0; lineY != 0.0f && v < lineLen * 6; ++v)
+                lineVertices[v * 5 + 1] += lineY;
+            glyphs += lineLen;
+
+            if (!lineEnd)
+                break;
+            line = lineEnd;
+            lineY -= lineHeight;
+        }
+        if (glyphs == 0)
+            return;
+
+        StreamBuffer::Allocation allocation = txf->textStream.upload(vertices, glyphs * cGlyphFloats * sizeof(GLfloat));
+        const GLsizei stride = 5 * sizeof(GLfloat);
+        glVertexAttrib2f(vertexOffsetIndex, x, y);
+        glVertexAttribPointer(vertexPositionIndex, 3, GL_FLOAT, GL_FALSE, stride, (const void*)allocation.offset);
+        glVertexAttribPointer(vertexTexCoordIndex, 2, GL_FLOAT, GL_FALSE, stride, (const void*)(allocation.offset + 3 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(vertexTexCoordIndex);
+        glDrawArrays(GL_TRIANGLES, 0, glyphs * 6);
+        glDisableVertexAttribArray(vertexTexCoordIndex);
+    }
+}
+
+void
+txfUnloadFont(TexFont * txf)
+{
+    if (txf)
+    {
+        // The texture and string VBOs are deleted with txf
         delete[] txf->teximage;
         delete[] txf->tgi;
         delete[] txf->tgvi;
         delete[] txf->lut;
+        delete txf->glyphTable;
         delete txf;
     }
 }
\ No newline at end of file
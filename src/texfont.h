@@ -7,6 +7,8 @@
 #include <string>
 #include <unordered_map>
 #include <SDL_opengles2.h>
+#include "streambuffer.h"
+#include "mipmap.h"
 
 enum TxfFormat {TXF_FORMAT_BYTE, TXF_FORMAT_BITMAP};
 
@@ -35,8 +37,24 @@ typedef struct {
     GLfloat vertexArray[(3+2)*4];
 } TexGlyphVertexInfo;
 
+// Glyph run tables over all byte values, built at load with case substitution applied. Each glyph's quad is
+// stored as the 6 vertices (x,y,z,u,v) it's drawn with, at the origin and padded to 32 floats, and its advance
+// separately, so the prefix sum over a string's advances reads only advances. Missing glyphs are empty.
 typedef struct {
-    GLuint texobj;
+    GLfloat quads[256][32];
+    GLfloat advances[256];
+    unsigned char present[256];
+} TexGlyphTable;
+
+// Per glyph instance for GPU text layout: pen position and glyph table index, 12 bytes
+typedef struct {
+    GLfloat pen[2];
+    GLubyte glyph;
+    GLubyte pad[3];
+} TexGlyphInstance;
+
+typedef struct {
+    GLTexture texobj;
     int tex_width;
     int tex_height;
     int max_ascent;
@@ -45,10 +63,21 @@ typedef struct {
     int min_glyph;
     int range;
     unsigned char *teximage;
+    std::vector<MipLevel> mipLevels;     // Levels 1 and on, if built by txfBuildMipmaps
     TexGlyphInfo *tgi;
     TexGlyphVertexInfo *tgvi;
     TexGlyphVertexInfo **lut;
-    std::unordered_map<std::string, GLuint> stringVBOs;
+    TexGlyphTable *glyphTable;
+    std::unordered_map<std::string, GLBuffer> stringVBOs;
+    std::string stringKey;
+
+    // Dynamic text (txfRenderText), streamed per frame
+    StreamBuffer textStream;
+    bool gpuLayout;
+    GLTexture metricsTexture;
+    GLBuffer cornerVbo;
+    PFNGLDRAWARRAYSINSTANCEDANGLEPROC drawArraysInstanced;
+    PFNGLVERTEXATTRIBDIVISORANGLEPROC vertexAttribDivisor;
 } TexFont;
 
 extern char *txfErrorString(void);
@@ -63,6 +92,13 @@ extern GLuint txfEstablishTexture(
     TexFont * txf,
     GLuint texobj);
 
+// Build the texture's mip levels from each glyph's own texels (see buildAtlasMipmaps), for txfEstablishTexture to
+// upload, so heavily minified text can be drawn with GL_LINEAR_MIPMAP_LINEAR. Needs power of 2 texture dimensions;
+// returns false otherwise. Doesn't use GL.
+extern bool txfBuildMipmaps(
+    TexFont * txf,
+    MipStats *stats = nullptr);
+
 extern void txfBindFontTexture(
     TexFont * txf);
 
@@ -74,7 +110,46 @@ extern void txfGetStringMetrics(
     int *max_ascent,
     int *max_descent);
 
+// Writes len glyphs of str as 6 vertices (x,y,z,u,v) each, laid out from the origin, to vertices (len * 30 floats),
+// and returns the run's advance. Long strings are split into chunks built in parallel when parallel is true.
+extern GLfloat txfBuildGlyphRun(
+    TexFont * txf,
+    const char *str,
+    int len,
+    GLfloat *vertices,
+    bool parallel = true);
+
+// Draws string with its origin at x,y. Strings are cached as VBOs built at the origin, so the caller's
+// shader adds the position from the constant vertex attribute at index 2 (with position at 0, texCoord at 1).
 extern void txfRenderString(
     TexFont * txf,
     const char *string,
     float x, float y);
+
+// GPU text layout: the glyph table's quad offsets, sizes and atlas positions go in a 512x1 RGBA metrics texture,
+// 2 texels per glyph, and text is drawn as one instance per glyph of TexGlyphInstance, which the caller's vertex
+// shader expands to a quad. Needs vertex texture fetch and ANGLE_instanced_arrays; returns false if unavailable.
+// Call on the GL thread.
+extern bool txfInitGpuLayout(
+    TexFont * txf);
+
+// Lay out text from x,y, starting a new line at each '\n', as one instance per drawn glyph (at most strlen(text)).
+// Returns the instance count.
+extern int txfLayoutText(
+    TexFont * txf,
+    const char *text,
+    float x, float y,
+    TexGlyphInstance *instances);
+
+// Call once per frame before drawing dynamic text, to move on to the next stream buffer
+extern void txfBeginFrame(
+    TexFont * txf);
+
+// Draw text that changes often, such as logs and tables, without caching it. With GPU layout, the caller's
+// program takes attributes corner (index 0), pen (1) and glyph (2), and a metrics sampler on texture unit 1.
+// Otherwise it takes the same attributes as txfRenderString, with quads built on the CPU and streamed.
+// Attribute 0 is left to the caller to enable; 1 and 2 are left disabled.
+extern void txfRenderText(
+    TexFont * txf,
+    const char *text,
+    float x, float y);
@@ -0,0 +1,205 @@
+//
+// Texture manager - keeps textures within a GPU memory budget, evicting least recently used ones and reloading them on use
+//
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_opengles2.h>
+#include "texturemanager.h"
+
+// #define TEXTUREMANAGER_DEBUG
+
+TextureManager::TextureManager(size_t budget)
+    : mBudget (budget)
+    , mFrame (0)
+    , mFramesOverBudget (0)
+    , mOverBudget (false)
+    , mCurrentStats ({})
+    , mFrameStats ({})
+    , mTotalStats ({})
+{
+}
+
+void TextureManager::parseArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+        if (!strcmp(argv[i], "--texture-budget") && i + 1 < argc)
+            setBudget((size_t)(std::max(0.0, atof(argv[++i])) * 1024 * 1024));
+}
+
+TextureManager& TextureManager::shared()
+{
+    static TextureManager manager;
+    return manager;
+}
+
+int TextureManager::add(const char* name, GLTexture& texture, Loader loader, bool evictable)
+{
+    mEntries.push_back({ name, &texture, loader, evictable, false, mFrame });
+    return (int)mEntries.size() - 1;
+}
+
+void TextureManager::remove(int handle)
+{
+    if (handle < 0 || handle >= (int)mEntries.size())
+        return;
+
+    Entry& entry = mEntries[handle];
+    entry.texture = nullptr;
+    entry.loader = nullptr;
+}
+
+void TextureManager::setEvictable(int handle, bool evictable)
+{
+    if (handle < 0 || handle >= (int)mEntries.size())
+        return;
+
+    mEntries[handle].evictable = evictable;
+}
+
+GLuint TextureManager::use(int handle)
+{
+    if (handle < 0 || handle >= (int)mEntries.size() || !mEntries[handle].texture)
+        return 0;
+
+    Entry& entry = mEntries[handle];
+    if (entry.texture->id() == 0 && entry.loader && !entry.loadFailed)
+        load(entry);
+    entry.lastUsedFrame = mFrame;
+    return entry.texture->id();
+}
+
+void TextureManager::reload(int handle)
+{
+    if (handle < 0 || handle >= (int)mEntries.size())
+        return;
+
+    Entry& entry = mEntries[handle];
+    if (entry.texture && entry.loader)
+        load(entry);
+}
+
+void TextureManager::load(Entry& entry)
+{
+    Uint64 startCounter = SDL_GetPerformanceCounter();
+    entry.loader();
+    double ms = (SDL_GetPerformanceCounter() - startCounter) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    mCurrentStats.loads++;
+    mCurrentStats.loadMs += ms;
+
+    // Don't retry a failed load every frame; only an explicit reload tries again
+    entry.loadFailed = (entry.texture->id() == 0);
+    if (entry.loadFailed)
+        printf("ERROR: Texture %s failed to load\n", entry.name.c_str());
+
+    #ifdef TEXTUREMANAGER_DEBUG
+        printf("loaded texture %s, %.1f KB in %.2f ms\n", entry.name.c_str(), entry.texture->paddedBytes() / 1024.0, ms);
+    #endif
+}
+
+size_t TextureManager::residentBytes()
+{
+    size_t bytes = 0;
+    for (const Entry& entry : mEntries)
+        if (entry.texture)
+            bytes += entry.texture->paddedBytes();
+    return bytes;
+}
+
+void TextureManager::countResident(Stats& stats)
+{
+    stats.textures = stats.resident = 0;
+    for (const Entry& entry : mEntries)
+        if (entry.texture)
+        {
+            stats.textures++;
+            if (entry.texture->id() != 0)
+                stats.resident++;
+        }
+    stats.residentBytes = residentBytes();
+    stats.peakBytes = std::max(mTotalStats.peakBytes, stats.residentBytes);
+}
+
+void TextureManager::endFrame()
+{
+    // Evict least recently used textures until within budget. Textures used this frame are kept, since
+    // evicting them would only reload them next frame.
+    size_t bytes = residentBytes();
+    while (bytes > mBudget)
+    {
+        Entry* victim = nullptr;
+        for (Entry& entry : mEntries)
+            if (entry.texture && entry.evictable && entry.texture->id() != 0 && entry.lastUsedFrame < mFrame
+                && (!victim || entry.lastUsedFrame < victim->lastUsedFrame))
+                victim = &entry;
+        if (!victim)
+            break;
+
+        #ifdef TEXTUREMANAGER_DEBUG
+            printf("evicted texture %s, %.1f KB, last used %u frames ago\n", victim->name.c_str(),
+                   victim->texture->paddedBytes() / 1024.0, mFrame - victim->lastUsedFrame);
+        #endif
+        bytes -= victim->texture->paddedBytes();
+        victim->texture->reset();
+        mCurrentStats.evictions++;
+    }
+
+    // Report going over budget once, rather than every frame it lasts
+    bool overBudget = bytes > mBudget;
+    if (overBudget)
+    {
+        mFramesOverBudget++;
+        if (!mOverBudget)
+            printf("INFO: Textures over budget, %.1f KB resident of %.1f KB, with nothing left to evict\n",
+                   bytes / 1024.0, mBudget / 1024.0);
+    }
+    mOverBudget = overBudget;
+
+    countResident(mCurrentStats);
+    mTotalStats.textures = mCurrentStats.textures;
+    mTotalStats.resident = mCurrentStats.resident;
+    mTotalStats.residentBytes = mCurrentStats.residentBytes;
+    mTotalStats.peakBytes = mCurrentStats.peakBytes;
+    mTotalStats.loads += mCurrentStats.loads;
+    mTotalStats.evictions += mCurrentStats.evictions;
+    mTotalStats.loadMs += mCurrentStats.loadMs;
+
+    #ifdef TEXTUREMANAGER_DEBUG
+        if (mCurrentStats.loads || mCurrentStats.evictions)
+            printf("frame %u textures %d/%d resident %.1f KB, %u loads in %.2f ms, %u evictions\n", mFrame,
+                   mCurrentStats.resident, mCurrentStats.textures, mCurrentStats.residentBytes / 1024.0,
+                   mCurrentStats.loads, mCurrentStats.loadMs, mCurrentStats.evictions);
+    #endif
+
+    mFrameStats = mCurrentStats;
+    mCurrentStats = {};
+    mFrame++;
+}
+
+// Totals so far, including the current frame
+void TextureManager::printReport(const char* label)
+{
+    Stats stats = mTotalStats;
+    countResident(stats);
+    stats.loads += mCurrentStats.loads;
+    stats.evictions += mCurrentStats.evictions;
+    stats.loadMs += mCurrentStats.loadMs;
+
+    printf("INFO: Textures %s: %d/%d resident, %.1f KB (peak %.1f KB) of %.1f KB budget, "
+           "%u loads in %.2f ms, %u evictions, %u frames over budget\n", label,
+           stats.resident, stats.textures, stats.residentBytes / 1024.0, stats.peakBytes / 1024.0, mBudget / 1024.0,
+           stats.loads, stats.loadMs, stats.evictions, mFramesOverBudget);
+}
+
+int TextureManager::writeReport(char* buffer, size_t size)
+{
+    const Stats& managed = mTotalStats;
+    return snprintf(buffer, size,
+                    "managed textures %d resident %d KB %.1f peak %.1f budget %.1f\n"
+                    "managed texture loads %u ms %.3f evictions %u frames over budget %u\n",
+                    managed.textures, managed.resident, managed.residentBytes / 1024.0, managed.peakBytes / 1024.0,
+                    mBudget / 1024.0, managed.loads, managed.loadMs, managed.evictions, mFramesOverBudget);
+}
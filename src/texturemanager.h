@@ -0,0 +1,83 @@
+//
+// Texture manager - keeps textures within a GPU memory budget, evicting least recently used ones and reloading them on use
+//
+// Requires SDL_opengles2.h to be included first.
+//
+#pragma once
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "glresource.h"
+
+class TextureManager
+{
+public:
+    // (Re)creates a texture's GL texture and uploads its contents, e.g. by regenerating or re-decoding its image
+    typedef std::function<void()> Loader;
+
+    TextureManager(size_t budget = 64 << 20);
+
+    // Shared manager for the main (GL) thread; not thread safe
+    static TextureManager& shared();
+
+    // Command line flags:
+    //     --texture-budget <MB>  Texture memory budget (default 64), e.g. 0.1 to force evictions
+    void parseArgs(int argc, char** argv);
+
+    // Budget in bytes, over textures' power of two padded sizes (see GLTexture::paddedBytes)
+    void setBudget(size_t budget) { mBudget = budget; }
+    size_t budget() const { return mBudget; }
+
+    // Manage a texture owned by the caller, which must outlive it or be removed first. If the texture is empty,
+    // the loader runs on first use. Evictable textures are deleted when over budget and reloaded on their next use;
+    // others count towards the budget but stay resident.
+    int add(const char* name, GLTexture& texture, Loader loader, bool evictable = true);
+    void remove(int handle);
+
+    // Pin a texture resident while it's being filled in over several frames, e.g. by a stream, then release it
+    void setEvictable(int handle, bool evictable);
+
+    // Mark a texture used this frame, reloading it first if it was evicted, and return its GL name (0 for no texture)
+    GLuint use(int handle);
+
+    // Rerun a texture's loader now, e.g. when its contents depend on the window size
+    void reload(int handle);
+
+    // Call once per frame after drawing, e.g. after EventHandler::swapWindow. Evicts the least recently used textures
+    // not used this frame until within budget.
+    void endFrame();
+
+    // frame is the last ended frame's loads and evictions, total is over all frames
+    struct Stats
+    {
+        int textures, resident;
+        size_t residentBytes, peakBytes;
+        unsigned int loads, evictions;
+        double loadMs;
+    };
+    const Stats& frameStats() const { return mFrameStats; }
+    const Stats& totalStats() const { return mTotalStats; }
+    unsigned int framesOverBudget() const { return mFramesOverBudget; }
+    void printReport(const char* label);
+    int writeReport(char* buffer, size_t size); // Replay report lines, see EventHandler::addReportSection
+
+private:
+    struct Entry
+    {
+        std::string name;
+        GLTexture* texture;
+        Loader loader;
+        bool evictable, loadFailed;
+        unsigned int lastUsedFrame;
+    };
+    void load(Entry& entry);
+    size_t residentBytes();
+    void countResident(Stats& stats);
+
+    size_t mBudget;
+    std::vector<Entry> mEntries;
+    unsigned int mFrame, mFramesOverBudget;
+    bool mOverBudget;
+    Stats mCurrentStats, mFrameStats, mTotalStats;
+};
@@ -0,0 +1,219 @@
+//
+// Thread pool - work stealing task scheduler for CPU side pipeline stages (image generation, decoding, font expansion)
+//
+#include <algorithm>
+#include <stdio.h>
+#include "threadpool.h"
+
+// #define THREADPOOL_DEBUG
+
+static int sharedThreadCount = 0;
+
+#ifdef THREADPOOL_THREADS
+// The pool the current thread works for, and its index in it
+static thread_local ThreadPool* tCurrentPool = nullptr;
+static thread_local int tCurrentThread = 0;
+#endif
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool* pool = nullptr;
+    if (!pool)
+    {
+        int threadCount = sharedThreadCount;
+#ifdef THREADPOOL_THREADS
+        if (threadCount <= 0)
+            threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+#endif
+        pool = new ThreadPool(threadCount - 1);
+        printf("INFO: Thread pool with %d threads\n", pool->threadCount());
+    }
+    return *pool;
+}
+
+void ThreadPool::setThreadCount(int threadCount)
+{
+    sharedThreadCount = threadCount;
+}
+
+int ThreadPool::currentThread()
+{
+#ifdef THREADPOOL_THREADS
+    return tCurrentThread;
+#else
+    return 0;
+#endif
+}
+
+#ifdef THREADPOOL_THREADS
+
+ThreadPool::ThreadPool(int workerCount)
+    : mWorkerCount (std::max(0, workerCount))
+    , mQueues (mWorkerCount + 1)
+    , mQueuedTasks (0)
+    , mStop (false)
+{
+    for (int i = 0; i < mWorkerCount; ++i)
+        mWorkers.emplace_back(&ThreadPool::workerLoop, this, i + 1);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mStop = true;
+    }
+    mWake.notify_all();
+    for (std::thread& worker : mWorkers)
+        worker.join();
+}
+
+void ThreadPool::submit(Task task)
+{
+    Queue& queue = mQueues[tCurrentPool == this ? tCurrentThread : 0];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mQueuedTasks++;
+    }
+    mWake.notify_one();
+}
+
+bool ThreadPool::runPendingTask()
+{
+    // Workers take the newest task from their own queue (likely still in cache), else steal the oldest task 
+    // from another queue. The shared queue of threads outside the pool is always taken oldest first.
+    const int queueCount = (int)mQueues.size(), self = tCurrentPool == this ? tCurrentThread : 0;
+    for (int i = 0; i < queueCount; ++i)
+    {
+        Queue& queue = mQueues[(self + i) % queueCount];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+
+        Task task;
+        if (i == 0 && self != 0)
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+
+            #ifdef THREADPOOL_DEBUG
+                printf("thread %d stole a task from queue %d\n", self, (self + i) % queueCount);
+            #endif
+        }
+        lock.unlock();
+        mQueuedTasks--;
+
+        runTask(task);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(int thread)
+{
+    tCurrentPool = this;
+    tCurrentThread = thread;
+    while (true)
+    {
+        if (runPendingTask())
+            continue;
+
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mWake.wait(lock, [this]() { return mStop || mQueuedTasks > 0; });
+        if (mStop)
+            return;
+    }
+}
+
+#else // THREADPOOL_THREADS
+
+ThreadPool::ThreadPool(int workerCount)
+    : mWorkerCount (0)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+}
+
+void ThreadPool::submit(Task task)
+{
+    runTask(task);
+}
+
+bool ThreadPool::runPendingTask()
+{
+    return false;
+}
+
+#endif // THREADPOOL_THREADS
+
+void ThreadPool::runTask(Task& task)
+{
+    task.fn();
+    task.group->mRemaining--;
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grainSize, const std::function<void(int, int)>& fn)
+{
+    const int count = end - begin;
+    if (count <= 0)
+        return;
+
+    // A few chunks per thread, for load balancing through stealing
+    int chunkSize = std::max(std::max(1, grainSize), (count + threadCount() * 4 - 1) / (threadCount() * 4));
+    if (mWorkerCount == 0 || chunkSize >= count)
+    {
+        fn(begin, end);
+        return;
+    }
+
+    TaskGroup group(*this);
+    for (int chunkBegin = begin + chunkSize; chunkBegin < end; chunkBegin += chunkSize)
+    {
+        int chunkEnd = std::min(chunkBegin + chunkSize, end);
+        group.run([&fn, chunkBegin, chunkEnd]() { fn(chunkBegin, chunkEnd); });
+    }
+    fn(begin, begin + chunkSize);
+    group.wait();
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+    : mPool (pool)
+    , mRemaining (0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    wait();
+}
+
+void TaskGroup::run(std::function<void()> fn)
+{
+    mRemaining++;
+    mPool.submit({std::move(fn), this});
+}
+
+void TaskGroup::wait()
+{
+    // Help with queued tasks (ours or others') until our tasks are done; they may be running on other threads
+    while (mRemaining > 0)
+    {
+        if (!mPool.runPendingTask())
+        {
+#ifdef THREADPOOL_THREADS
+            std::this_thread::yield();
+#endif
+        }
+    }
+}
@@ -0,0 +1,83 @@
+//
+// Thread pool - work stealing task scheduler for CPU side pipeline stages (image generation, decoding, font expansion)
+//
+// Threads are used natively, and in Emscripten builds linked with -s USE_PTHREADS=1 (with -s PTHREAD_POOL_SIZE=N,
+// so workers exist before the main thread blocks on them). Other builds run every task inline on the calling thread.
+//
+#pragma once
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define THREADPOOL_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+class TaskGroup;
+
+class ThreadPool
+{
+public:
+    // Shared pool, created on first use with one worker per core besides the calling thread,
+    // or threadCount - 1 workers if setThreadCount() was called first
+    static ThreadPool& shared();
+    static void setThreadCount(int threadCount);
+
+    ThreadPool(int workerCount);
+    ~ThreadPool();
+
+    // Threads that run tasks: the workers, plus a thread waiting on a task group
+    int threadCount() { return mWorkerCount + 1; }
+
+    // 0 on threads outside the pool (e.g. the main thread), 1..workers on pool workers
+    static int currentThread();
+
+    // Run one queued task on the calling thread, own queue first, else stolen from another thread's queue.
+    // Returns false if there was none.
+    bool runPendingTask();
+
+    // Call fn(rangeBegin, rangeEnd) over [begin,end) split into chunks of at least grainSize, and wait for them
+    void parallelFor(int begin, int end, int grainSize, const std::function<void(int, int)>& fn);
+
+private:
+    friend class TaskGroup;
+    struct Task { std::function<void()> fn; TaskGroup* group; };
+    void submit(Task task);
+    void runTask(Task& task);
+
+    int mWorkerCount;
+
+#ifdef THREADPOOL_THREADS
+    // Per-thread deques: owners push and pop at the back, thieves take from the front. Index 0 is shared
+    // by threads outside the pool.
+    struct Queue { std::mutex mutex; std::deque<Task> tasks; };
+    void workerLoop(int thread);
+
+    std::vector<Queue> mQueues;
+    std::vector<std::thread> mWorkers;
+    std::atomic<int> mQueuedTasks;
+    std::mutex mWakeMutex;
+    std::condition_variable mWake;
+    bool mStop;
+#endif
+};
+
+// Tasks that can be waited on together. Waiting runs queued tasks rather than blocking, so groups can nest.
+class TaskGroup
+{
+public:
+    TaskGroup(ThreadPool& pool = ThreadPool::shared());
+    ~TaskGroup();
+
+    void run(std::function<void()> fn);
+    void wait();
+
+private:
+    friend class ThreadPool;
+    ThreadPool& mPool;
+    std::atomic<int> mRemaining;
+};